@@ -0,0 +1,113 @@
+/*******************************************************************************
+Test that evaluating distances does not allocate memory
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "cosmo.h"
+
+using namespace std;
+
+// Every allocation with new goes through these, so counting them here
+// counts the allocations of the library and the standard containers.
+static size_t allocations = 0;
+static volatile double sink;    // keeps the quantities from being discarded
+
+void* operator new(size_t n)
+{
+    ++allocations;
+    if (void* p = malloc(n ? n : 1))
+        return p;
+    throw bad_alloc();
+}
+
+void* operator new[](size_t n)
+{
+    return operator new(n);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// Sets each redshift and reads every quantity derived from it, which does
+// the integrals; returns the number of allocations made meanwhile.
+static size_t count(Cosmo& c)
+{
+    const double z[] = { 0, 1e-6, 0.1, 0.5, 1, 2.5, 10, 1100 };
+    double sum = 0;
+    size_t before = allocations;
+    for (size_t k = 0; k < sizeof(z) / sizeof(z[0]); ++k)
+    {
+        c.setRedshift(z[k]);
+        sum += c.dL() + c.dA() + c.dC() + c.dM() + c.VC() + c.lookback()
+             + c.scale() + c.rhoCrit();
+    }
+    sink = sum;
+    return allocations - before;
+}
+
+int main()
+{
+    const double params[][3] = { { 71, 0.27, 0.73 },  // flat, closed forms
+                                 { 70, 0.3, 0 },      // open
+                                 { 70, 0.3, 0.8 },    // closed
+                                 { 70, 1, 0 } };      // Einstein-de Sitter
+    const Cosmo::Integrator engines[] = { Cosmo::ROMBERG,
+                                          Cosmo::GAUSS_KRONROD };
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); ++i)
+        for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e)
+        {
+            Cosmo c(params[i][0], params[i][1], params[i][2]);
+            c.setIntegrator(engines[e]);
+            size_t n = count(c);
+            if (n)
+            {
+                printf("alloc_test: %zu allocations for H0 = %g, "
+                       "Omega_m = %g, Omega_L = %g, engine %d\n", n,
+                       params[i][0], params[i][1], params[i][2], int(e));
+                ++failures;
+            }
+        }
+    printf("alloc_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
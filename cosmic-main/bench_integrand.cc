@@ -0,0 +1,152 @@
+/*******************************************************************************
+Benchmark of integrand dispatch in Romberg integration
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+// Times 20000 Romberg integrals of 1/E(z) in an open cosmology, once with
+// the integrand passed as a pointer to a member function, as Cosmo did
+// before the integrators became templates, and once as a lambda to the
+// template romberg() of integrate.h. Both sum the same abscissae in the
+// same order, so they must give the same results.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "integrate.h"
+
+using namespace std;
+
+// the integrands of Cosmo for a cosmology without a closed form
+class Integrands
+{
+private:
+    double OmegaM_, Omegak_, OmegaL_;
+
+public:
+    Integrands(const double om, const double ol)
+        : OmegaM_(om), Omegak_(1 - om - ol), OmegaL_(ol) {}
+    inline double E(const double z)
+    {
+        double a = 1 + z;
+        return sqrt((OmegaM_ * a + Omegak_) * a * a + OmegaL_);
+    }
+    double inverseOfE(const double z) { return 1 / E(z); }
+};
+
+typedef double (Integrands::*PFD)(const double);
+
+// The integrand is read from here at run time, as Cosmo picked it from
+// its callers, so the compiler cannot resolve the calls through it.
+PFD integrand = &Integrands::inverseOfE;
+
+// Romberg integration as it was before integrate.h: the same two-row
+// tableau, calling the integrand through a pointer to member function
+static double romberg(Integrands& o, PFD func, double a, double b)
+{
+    double h = b - a;     // coarsest panel size
+    double dR;            // convergence
+    int np = 1;           // Current number of panels
+    const int N = 25;     // maximum iterations
+    double prec = 1e-8;   // desired precision
+    double rows[2][N];
+    double* prev = rows[0]; // R(i-1, ...)
+    double* cur = rows[1];  // R(i, ...)
+    // Compute the first term R(1,1)
+    prev[0] = h/2 * ((o.*func)(a) + (o.*func)(b));
+
+    // Loop over the desired number of rows, i = 2,...,N
+    int i,j,k;
+    for(i = 1; i < N; ++i)
+    {
+        // Compute the summation in the recursive trapezoidal rule
+        h /= 2.0;          // Use panels half the previous size
+        np *= 2;           // Use twice as many panels
+        double sumT = 0.0;
+        for( k=1; k<=(np-1); k+=2 )
+            sumT += (o.*func)( a + k*h);
+
+        // Compute Romberg table entries R(i,1), R(i,2), ..., R(i,i)
+        cur[0] = 0.5 * prev[0] + h * sumT;
+        int m = 1;
+        for( j=1; j<i; ++j )
+        {
+            m *= 4;
+            cur[j] = cur[j-1] + (cur[j-1] - prev[j-1]) / (m-1);
+        }
+        dR = (j > 1) ? cur[j-1] - prev[j-2] : prev[0];
+        if (fabs(dR) < prec)
+            return cur[j-1];
+        double* t = prev;
+        prev = cur;
+        cur = t;
+    }
+    return prev[N-2];
+}
+
+// best of several runs of body, in milliseconds
+template <class F>
+static double best(F body)
+{
+    double t = 1e300;
+    for (int run = 0; run < 7; ++run)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        body();
+        chrono::duration<double, milli> d = chrono::steady_clock::now() - start;
+        t = min(t, d.count());
+    }
+    return t;
+}
+
+int main()
+{
+    Integrands o(0.3, 0);
+    vector<double> z(20000), pointer(z.size()), lambda(z.size());
+    for (size_t i = 0; i < z.size(); ++i)
+        z[i] = 10.0 * (i + 1) / z.size();
+
+    double tp = best([&]()
+    {
+        for (size_t i = 0; i < z.size(); ++i)
+            pointer[i] = romberg(o, integrand, 0, z[i]);
+    });
+    double tl = best([&]()
+    {
+        for (size_t i = 0; i < z.size(); ++i)
+            lambda[i] = romberg([&o](const double x) { return o.inverseOfE(x); },
+                                0.0, z[i]);
+    });
+
+    size_t differ = 0;
+    for (size_t i = 0; i < z.size(); ++i)
+        if (pointer[i] != lambda[i])
+            ++differ;
+    printf("%zu Romberg integrals of 1/E(z), Omega_m = 0.3, Omega_L = 0\n",
+           z.size());
+    printf("  pointer to member  %8.2f ms\n", tp);
+    printf("  template, lambda   %8.2f ms  (%.2fx)\n", tl, tp / tl);
+    printf("  results differing  %zu\n", differ);
+    return differ ? 1 : 0;
+}
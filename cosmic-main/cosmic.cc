@@ -2,7 +2,7 @@
 Program to calculate cosmological distances in standard Lambda cosmology
 Copyright (C) 2003-2021  Joshua Kempner
 
-Version 2.1.0
+Version 2.2.0
 
 This program is free software; you can redistribute it and/or
 modify it under the terms of the GNU General Public License
@@ -31,12 +31,17 @@ josh@kempner.net.
 #include <map>
 #include <cstring>
 #include <limits>
+#include <sstream>
+#include <vector>
+#include <algorithm>
 
 #include "cosmo.h"
+#include "redshiftfile.h"
+#include "npy.h"
 
 using namespace std;
 
-string version = "2.1.0";
+string version = "2.2.0";
 
 void help()
 {
@@ -51,6 +56,18 @@ void help()
        << "   html=yes     - output formatted in HTML"
        << "   batch=file   - run in batch mode using redshifts in \"file\"\n"
        << "   outfile=file - output batch mode results to \"file\"\n"
+       << "   grid=file    - evaluate the batch redshifts for every cosmology\n"
+       << "                  (\"H0 Omega_m Omega_L\" per line) in \"file\"\n"
+       << "   threads=N    - number of threads for batch mode (default = 1,\n"
+       << "                  0 = one per processor)\n"
+       << "   timing=yes   - report the busy time of each batch mode thread\n"
+       << "   digits=N     - significant digits of batch mode output\n"
+       << "                  (default = 6, 0 = shortest exact)\n"
+       << "   format=npy   - write batch mode output as one NumPy .npy file\n"
+       << "                  per quantity, named outfile_<quantity>.npy\n"
+       << "   pipe=yes     - batch mode from standard input to standard\n"
+       << "                  output (same as quiet=yes prompt=no batch=-\n"
+       << "                  outfile=-)\n"
        << "   help=yes     - print this message\n"
        << "   version=yes  - print the version number of cosmic\n";
   exit(0);
@@ -159,6 +176,220 @@ void processArgs(int argc, char** argv, map<string, bool>& bflags,
     cerr << endl;
 }
 
+// prints the results for the redshifts in z to os in input order, as
+// printShort() would with the given significant digits, and returns the
+// number of distinct redshifts. Each distinct redshift is evaluated only
+// once and its line repeated for every copy. The scheduler hands out
+// chunks of the distinct redshifts to its threads, which share c through
+// Cosmo::evaluate(); thread t appends their lines to its own buffer, from
+// which they are put back in order and written with a single call.
+size_t printShortBatch(Scheduler& scheduler, const Cosmo& c,
+                       const vector<double>& z, const int digits,
+                       ostream& os)
+{
+    vector<double> unique;
+    vector<size_t> index;
+    size_t nUnique = uniqueRedshifts(z.data(), z.size(), unique, index);
+
+    int nThreads = scheduler.threads();
+    vector<string> text(nThreads);
+    vector<int> owner(nUnique);         // thread whose buffer has the line
+    vector<size_t> start(nUnique);      // offset of the line in the buffer
+    vector<size_t> length(nUnique);
+    scheduler.run(nUnique, [&](size_t begin, size_t end, int t)
+    {
+        char line[Cosmo::SHORT_LINE_MAX];
+        for (size_t i = begin; i < end; ++i)
+        {
+            char* eol = c.formatShort(line, c.evaluate(unique[i], Cosmo::D_A
+                                                       | Cosmo::D_L
+                                                       | Cosmo::D_C
+                                                       | Cosmo::SCALE
+                                                       | Cosmo::T_L),
+                                      digits);
+            owner[i] = t;
+            start[i] = text[t].size();
+            length[i] = eol - line;
+            text[t].append(line, length[i]);
+        }
+    });
+
+    size_t total = 0;
+    for (size_t i = 0; i < z.size(); ++i)
+        total += length[index[i]];
+    string out;
+    out.reserve(total);
+    for (size_t i = 0; i < z.size(); ++i)
+    {
+        size_t j = index[i];
+        out.append(text[owner[j]], start[j], length[j]);
+    }
+    os.write(out.data(), out.size());
+    return nUnique;
+}
+
+// Reads the grid file, one cosmology per line as "H0 OmegaM OmegaL";
+// blank lines and lines starting with "#" are skipped. Returns false after
+// reporting the first invalid line.
+bool readGrid(istream& in, vector<CosmoParams>& grid)
+{
+    string text;
+    int line = 0;
+    while (getline(in, text))
+    {
+        ++line;
+        istringstream fields(text);
+        string h, m, l, extra;
+        if (!(fields >> h))
+            continue;
+        if ('#' == h[0])
+            continue;
+        if (!(fields >> m >> l) || (fields >> extra) || !isNumeric(h)
+            || !isNumeric(m) || !isNumeric(l) || atof(h.c_str()) <= 0)
+        {
+            cerr << "Invalid cosmology in grid file on line " << line << endl;
+            return false;
+        }
+        CosmoParams p = { atof(h.c_str()), atof(m.c_str()), atof(l.c_str()) };
+        grid.push_back(p);
+    }
+    return true;
+}
+
+// prints the quantities of printShort() at every redshift in z for every
+// cosmology in grid, one block with its own header per cosmology, written
+// with a single call
+void printShortGrid(Scheduler& scheduler, const vector<CosmoParams>& grid,
+                    const vector<double>& z, const int digits, ostream& os)
+{
+    GridCube cube;
+    sweepGrid(grid, z, Cosmo::D_A | Cosmo::D_L | Cosmo::D_C | Cosmo::SCALE
+              | Cosmo::T_L, cube, scheduler);
+    // slots of the quantities in the cube, in the order of the Quantity bits
+    const size_t dC = 0, dA = 1, dL = 2, tL = 3, scale = 4;
+    for (size_t i = 0; i < cube.nCosmo; ++i)
+    {
+        Cosmo c(grid[i].H0, grid[i].OmegaM, grid[i].OmegaL);
+        if (i)
+            os << "\n";
+        c.printShortHeader(os);
+        string out;
+        char line[Cosmo::SHORT_LINE_MAX];
+        for (size_t j = 0; j < cube.nZ; ++j)
+        {
+            Distances d = { z[j], cube.at(i, j, dA), cube.at(i, j, dL),
+                            cube.at(i, j, dC), 0, 0, cube.at(i, j, tL),
+                            cube.at(i, j, scale), 0 };
+            out.append(line, c.formatShort(line, d, digits) - line);
+        }
+        os.write(out.data(), out.size());
+    }
+}
+
+// quantities written in npy format, one file each, with the Distances
+// member and the Cosmo::Quantity bit of each (0 for the redshift)
+const int nNpyColumns = 8;
+const char* npyNames[nNpyColumns] = { "z", "dA", "dL", "dC", "dM", "VC",
+                                      "scale", "tL" };
+double Distances::* const npyMembers[nNpyColumns] = {
+    &Distances::z, &Distances::dA, &Distances::dL, &Distances::dC,
+    &Distances::dM, &Distances::VC, &Distances::scale, &Distances::tL };
+const QuantityMask npyQuantities[nNpyColumns] = {
+    0, Cosmo::D_A, Cosmo::D_L, Cosmo::D_C, Cosmo::D_M, Cosmo::V_C,
+    Cosmo::SCALE, Cosmo::T_L };
+
+// Opens prefix_<quantity>.npy for every quantity, as arrays with rows of
+// the given length (0 = 1-d), except for the redshift, which is always
+// 1-d. Returns false after reporting a file that cannot be created.
+bool openNpy(const string& prefix, NpyFile* files, const size_t columns)
+{
+    for (int k = 0; k < nNpyColumns; ++k)
+    {
+        string name = prefix + "_" + npyNames[k] + ".npy";
+        if (!files[k].open(name, k ? columns : 0))
+        {
+            cerr << "Error opening output file: " << name << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// closes the files opened by openNpy(); returns false after reporting an
+// error
+bool closeNpy(const string& prefix, NpyFile* files)
+{
+    bool ok = true;
+    for (int k = 0; k < nNpyColumns; ++k)
+        if (!files[k].close())
+        {
+            cerr << "Error writing output file: " << prefix << "_"
+                 << npyNames[k] << ".npy" << endl;
+            ok = false;
+        }
+    return ok;
+}
+
+// Appends the quantities at the redshifts in z to the files opened by
+// openNpy(), in input order, and returns the number of distinct
+// redshifts. As in printShortBatch() each distinct redshift is evaluated
+// only once, by the threads of the scheduler sharing c. The values are
+// written as they are, in the units of the accessors of Cosmo.
+size_t writeNpyBatch(Scheduler& scheduler, const Cosmo& c,
+                     const vector<double>& z, NpyFile* files)
+{
+    vector<double> unique;
+    vector<size_t> index;
+    size_t nUnique = uniqueRedshifts(z.data(), z.size(), unique, index);
+
+    vector<Distances> d(nUnique);
+    scheduler.run(nUnique, [&](size_t begin, size_t end, int)
+    {
+        for (size_t i = begin; i < end; ++i)
+            d[i] = c.evaluate(unique[i], Cosmo::D_A | Cosmo::D_L | Cosmo::D_C
+                              | Cosmo::D_M | Cosmo::V_C | Cosmo::SCALE
+                              | Cosmo::T_L);
+    });
+
+    vector<double> column(z.size());
+    for (int k = 0; k < nNpyColumns; ++k)
+    {
+        for (size_t i = 0; i < z.size(); ++i)
+            column[i] = d[index[i]].*npyMembers[k];
+        files[k].write(column.data(), column.size());
+    }
+    return nUnique;
+}
+
+// Writes the quantities at every redshift in z for every cosmology in grid
+// to prefix_<quantity>.npy, each as an array of one row per cosmology and
+// one column per redshift. Returns false after reporting an error.
+bool writeNpyGrid(Scheduler& scheduler, const vector<CosmoParams>& grid,
+                  const vector<double>& z, const string& prefix)
+{
+    GridCube cube;
+    QuantityMask mask = 0;
+    for (int k = 0; k < nNpyColumns; ++k)
+        mask |= npyQuantities[k];
+    sweepGrid(grid, z, mask, cube, scheduler);
+
+    NpyFile files[nNpyColumns];
+    if (!openNpy(prefix, files, cube.nZ))
+        return false;
+    files[0].write(z.data(), z.size());
+    vector<double> column(cube.nCosmo * cube.nZ);
+    for (int k = 1; k < nNpyColumns; ++k)
+    {
+        size_t slot = find(cube.quantities.begin(), cube.quantities.end(),
+                           npyQuantities[k]) - cube.quantities.begin();
+        for (size_t i = 0; i < cube.nCosmo; ++i)
+            for (size_t j = 0; j < cube.nZ; ++j)
+                column[i * cube.nZ + j] = cube.at(i, j, slot);
+        files[k].write(column.data(), column.size());
+    }
+    return closeNpy(prefix, files);
+}
+
 int main(int argc, char** argv)
 {
     // default values for arguments
@@ -170,15 +401,29 @@ int main(int argc, char** argv)
     bflags["prompt"] = true;
     bflags["html"] = false;
     bflags["version"] = false;
+    bflags["timing"] = false;
+    bflags["pipe"] = false;
     sflags["batch"] = "";
+    sflags["grid"] = "";
     sflags["outfile"] = "cosmic.out";
+    sflags["format"] = "text";
     fflags["h"] = 71;
     fflags["m"] = 0.27;
     fflags["l"] = 0.73;
     fflags["z"] = -1;
+    fflags["threads"] = 1;
+    fflags["digits"] = 6;
     
     // process arguments
     processArgs(argc, argv, bflags, sflags, fflags);
+    if (bflags["pipe"])
+    {
+        // nothing but the results may go to the standard output
+        bflags["quiet"] = true;
+        bflags["prompt"] = false;
+        sflags["batch"] = "-";
+        sflags["outfile"] = "-";
+    }
     
     // print help message if requested
     if (bflags["help"])
@@ -238,41 +483,154 @@ int main(int argc, char** argv)
     }
     else
     {
-        ifstream inFile(sflags["batch"].c_str());
-        if (!inFile)
+        RedshiftFile inFile;
+        if (!inFile.open(sflags["batch"]))
         {
             cerr << "Error opening batch file: " << sflags["batch"] << endl;
             return 1;
         }
         
-        ofstream outFile(sflags["outfile"].c_str());
-        if (!outFile)
+        // in npy format the output file name is the prefix of the names
+        // of the .npy files
+        bool npy = "npy" == sflags["format"];
+        if (!npy && "text" != sflags["format"])
+        {
+            cerr << "Output format must be text or npy" << endl;
+            return 1;
+        }
+        string outName = sflags["outfile"];
+        if (npy && "cosmic.out" == outName)
+            outName = "cosmic";
+        // "-" is the standard output, and then the messages to the user go
+        // to the standard error
+        bool toStdout = "-" == outName;
+        if (npy && toStdout)
         {
-            cerr << "Error opening output file: " << sflags["outfile"] << endl;
+            cerr << "npy output needs a file name" << endl;
             return 1;
         }
+        ofstream outFile;
+        if (!npy && !toStdout)
+        {
+            outFile.open(outName.c_str());
+            if (!outFile)
+            {
+                cerr << "Error opening output file: " << outName << endl;
+                return 1;
+            }
+        }
+        ostream& out = toStdout ? cout : outFile;
+        ostream& info = toStdout ? cerr : cout;
         
+        int nThreads = int(fflags["threads"]);
+        if (nThreads != fflags["threads"] || nThreads < 0)
+        {
+            cerr << "Number of threads must be a non-negative integer" << endl;
+            return 1;
+        }
+        int digits = int(fflags["digits"]);
+        if (digits != fflags["digits"] || digits < 0 || digits > 17)
+        {
+            cerr << "Number of digits must be an integer from 0 to 17" << endl;
+            return 1;
+        }
+        Scheduler scheduler(nThreads); // 0 = one thread per processor
+        nThreads = scheduler.threads();
+        // bytes of the batch file parsed and evaluated at a time
+        const size_t blockBytes = (size_t(1) << 18) * nThreads;
+
         // short message to the user
-        cout << "Running in batch mode. Output will be in " << sflags["outfile"]
-            << endl;
+        if (!toStdout)
+            info << "Running in batch mode. Output will be in " << outName
+                 << (npy ? "_*.npy" : "") << endl;
         
-        // loop throught the batch file and output the redshifts to cosmic.out
-        int line = 0;
-        char p[100];
-        c->printShortHeader(outFile); // print a couple header lines
-        while (inFile.getline(p, 100))
+        if (sflags["grid"].length())
         {
-            ++line;
-            z = atof(p);
-            if (!z)
+            // the whole redshift list is evaluated for every cosmology of
+            // the grid, in parallel across cosmologies
+            ifstream gridFile(sflags["grid"].c_str());
+            if (!gridFile)
             {
-                cerr << "Non-numeric redshift found in batch file on line" << line
-                << "\nExiting with no further output" << endl;
+                cerr << "Error opening grid file: " << sflags["grid"] << endl;
                 return 1;
             }
-            
-            c->setRedshift(z);
-            c->printShort(outFile);
+            vector<CosmoParams> grid;
+            if (!readGrid(gridFile, grid))
+                return 1;
+            vector<double> zs, block;
+            while (!inFile.done())
+            {
+                if (!inFile.next(blockBytes, scheduler, block))
+                {
+                    cerr << "Malformed redshift in batch file on line "
+                         << inFile.badLine() << " (byte offset "
+                         << inFile.badOffset() << ")\nExiting with no output"
+                         << endl;
+                    return 1;
+                }
+                zs.insert(zs.end(), block.begin(), block.end());
+            }
+            if (npy)
+            {
+                if (!writeNpyGrid(scheduler, grid, zs, outName))
+                    return 1;
+            }
+            else
+                printShortGrid(scheduler, grid, zs, digits, out);
+            info << grid.size() << " cosmologies, " << zs.size()
+                 << " redshifts" << endl;
+            if (bflags["timing"])
+                for (int t = 0; t < nThreads; ++t)
+                    info << "thread " << t << ": busy "
+                         << scheduler.busyTime()[t] << " s, "
+                         << scheduler.chunks()[t] << " chunks, "
+                         << scheduler.steals()[t] << " steals" << endl;
+            delete c;
+            return 0;
+        }
+
+        // loop throught the batch file and output the redshifts to cosmic.out,
+        // parsing blocks of the file and evaluating their redshifts in
+        // parallel on the threads of the scheduler. Repeated redshifts are
+        // evaluated once per block.
+        vector<double> block;
+        bool badLine = false;
+        size_t nRedshifts = 0, nDistinct = 0;
+        NpyFile npyFiles[nNpyColumns];
+        if (npy)
+        {
+            if (!openNpy(outName, npyFiles, 0))
+                return 1;
+        }
+        else
+            c->printShortHeader(out); // print a couple header lines
+        while (!badLine && !inFile.done())
+        {
+            badLine = !inFile.next(blockBytes, scheduler, block);
+            if (npy)
+                nDistinct += writeNpyBatch(scheduler, *c, block, npyFiles);
+            else
+                nDistinct += printShortBatch(scheduler, *c, block, digits,
+                                             out);
+            nRedshifts += block.size();
+        }
+        if (npy && !closeNpy(outName, npyFiles))
+            return 1;
+        if (nDistinct)
+            info << nRedshifts << " redshifts, " << nDistinct
+                 << " evaluated (dedup ratio " << double(nRedshifts) / nDistinct
+                 << ")" << endl;
+        if (bflags["timing"])
+            for (int t = 0; t < nThreads; ++t)
+                info << "thread " << t << ": busy " << scheduler.busyTime()[t]
+                     << " s, " << scheduler.chunks()[t] << " chunks, "
+                     << scheduler.steals()[t] << " steals" << endl;
+        if (badLine)
+        {
+            cerr << "Malformed redshift in batch file on line "
+                 << inFile.badLine() << " (byte offset " << inFile.badOffset()
+                 << ")\nExiting with no further output" << endl;
+            return 1;
         }
         inFile.close();
         outFile.close();
@@ -2,7 +2,7 @@
 Definitions file for a cosmology library of general use in observational astronomy
 Copyright (C) 2003-2021  Joshua Kempner
 
-Version 2.1.5
+Version 2.2
 
 This program is free software; you can redistribute it and/or
 modify it under the terms of the GNU General Public License
@@ -29,8 +29,15 @@ josh@kempner.net.
 #include <cmath>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
 
 #include "cosmo.h"
+#include "integrate.h"
+#include "simd.h"
 
 using namespace std;
 
@@ -41,6 +48,204 @@ const double PI = atan(double(1)) * 4;
 const double kmPerMpc = 3.08567758e19;
 const double tropicalYear = 3.1556926e7; // in seconds
 
+// absolute tolerance of the dimensionless integrals in float32 mode
+const double FLOAT_TOLERANCE = 1e-6;
+
+// Carlson's symmetric elliptic integral R_F(x, conj(x), z) for complex x
+// and real z > 0, by the duplication theorem. The first two arguments stay
+// complex conjugates throughout, so only one complex square root is needed
+// per iteration and the result is real. Returns NaN for arguments that
+// are not finite, or if the iteration does not converge.
+static double carlsonRF(complex<double> x, double z)
+{
+    const double errTol = 0.0025; // truncation error ~ errTol^6
+    const int maxIter = 1000;     // ample for arguments 1e600 apart
+    if (!isfinite(x.real()) || !isfinite(x.imag()) || !isfinite(z))
+        return numeric_limits<double>::quiet_NaN();
+    double A, Z;
+    complex<double> X;
+    for (int i = 0;; ++i)
+    {
+        if (maxIter == i)
+            return numeric_limits<double>::quiet_NaN();
+        complex<double> sx = sqrt(x);
+        double sz = sqrt(z);
+        double lambda = norm(sx) + 2 * sx.real() * sz;
+        x = 0.25 * (x + lambda);
+        z = 0.25 * (z + lambda);
+        A = (2 * x.real() + z) / 3;
+        X = 1.0 - x / A;
+        Z = 1 - z / A;
+        if (max(abs(X), fabs(Z)) < errTol)
+            break;
+    }
+    double XY = norm(X);
+    double E2 = XY - Z * Z;
+    double E3 = XY * Z;
+    return (1 - E2 / 10 + E3 / 14 + E2 * E2 / 24 - 3 * E2 * E3 / 44) / sqrt(A);
+}
+
+// Neumaier's compensated summation: adds x to sum, accumulating the
+// rounding error in comp. The compensated total is sum + comp.
+static inline void addCompensated(double& sum, double& comp, const double x)
+{
+    double t = sum + x;
+    if (fabs(sum) >= fabs(x))
+        comp += (sum - t) + x;
+    else
+        comp += (x - t) + sum;
+    sum = t;
+}
+
+// Evaluates the Chebyshev series sum_j c[j] T_j(t) by Clenshaw's recurrence
+static double chebyshevSum(const vector<double>& c, const double t)
+{
+    double b1 = 0, b2 = 0;
+    for (size_t j = c.size() - 1; j > 0; --j)
+    {
+        double b0 = 2 * t * b1 - b2 + c[j];
+        b2 = b1;
+        b1 = b0;
+    }
+    return t * b1 - b2 + c[0];
+}
+
+// Integrands of the distance integrals: 1/E(z) for the comoving distance
+// and 1/((1+z) E(z)) for the lookback time, or both at once, evaluated in
+// the precision Real. Besides the pointwise operator() used by every
+// engine, sum() evaluates the Romberg trapezoid sums a SIMD vector of
+// abscissae at a time.
+enum { COMOVING = 1, LOOKBACK = 2, BOTH = COMOVING | LOOKBACK };
+
+template <int Which, class Real = double>
+struct DistanceKernel
+{
+    typedef typename Simd<Real>::type Vec;
+    static const int M = (BOTH == Which) ? 2 : 1; // number of components
+    Real Om, Ok, OL;
+    DistanceKernel(const double m, const double k, const double l)
+        : Om(m), Ok(k), OL(l) {}
+
+    // 1/E(z) for 1+z = x1, in any of the vector or scalar types
+    template <class T>
+    inline T inverseOfE(const T x1, const T one)
+    {
+        T x2 = x1 * x1;
+        return one / sqrt(T(Om) * (x2 * x1) + T(Ok) * x2 + T(OL));
+    }
+    inline void operator()(const double z, Real* f)
+    {
+        Real x1 = 1 + z;
+        Real inv = inverseOfE(x1, Real(1));
+        if (Which & COMOVING)
+            *f++ = inv;
+        if (Which & LOOKBACK)
+            *f = inv / x1;
+    }
+    // sum of the components at a + k*h for odd k < np
+    inline void sum(const double a, const double h, const int np, Real* s)
+    {
+        const Vec va(a), vh(h), one(1), step(2 * Vec::width);
+        Vec k = laneIndex<Vec, Real>() * Vec(2) + one;
+        Vec accC(0), accT(0);
+        int count = np / 2, j = 0;
+        for (; j + Vec::width <= count; j += Vec::width)
+        {
+            Vec x1 = one + (va + k * vh);
+            Vec inv = inverseOfE(x1, one);
+            if (Which & COMOVING)
+                accC += inv;
+            if (Which & LOOKBACK)
+                accT += inv / x1;
+            k += step;
+        }
+        Real sC = accC.sum(), sT = accT.sum();
+        for (; j < count; ++j)
+        {
+            Real x1 = 1 + (a + (2*j + 1) * h);
+            Real inv = inverseOfE(x1, Real(1));
+            sC += inv;
+            sT += inv / x1;
+        }
+        if (Which & COMOVING)
+            *s++ = sC;
+        if (Which & LOOKBACK)
+            *s = sT;
+    }
+};
+
+// Distance integrands for an ensemble of B cosmologies at once, one per
+// component, so that they are integrated together over shared abscissae.
+// The comoving components come first, then the lookback ones. The lanes of
+// VecD run across the cosmologies, so B must be a multiple of its width.
+template <int Which, int B>
+struct EnsembleKernel
+{
+    static const int M = (BOTH == Which) ? 2 * B : B; // number of components
+    double Om[B], Ok[B], OL[B];
+
+    inline void operator()(const double z, double* f)
+    {
+        const VecD x1(1 + z), one(1.0);
+        const VecD x2 = x1 * x1, x3 = x2 * x1;
+        for (int l = 0; l < B; l += VecD::width)
+        {
+            VecD inv = one / sqrt(VecD::load(Om + l) * x3 +
+                                  VecD::load(Ok + l) * x2 + VecD::load(OL + l));
+            if (Which & COMOVING)
+                inv.store(f + l);
+            if (Which & LOOKBACK)
+                (inv / x1).store(f + (M - B) + l);
+        }
+    }
+    // sum of the components at a + k*h for odd k < np, accumulated in
+    // registers across the abscissae
+    inline void sum(const double a, const double h, const int np, double* s)
+    {
+        const int vecsPerKind = B / VecD::width;
+        const VecD one(1.0);
+        VecD om[vecsPerKind], ok[vecsPerKind], ol[vecsPerKind];
+        VecD accC[vecsPerKind], accT[vecsPerKind];
+        int g;
+        for (g = 0; g < vecsPerKind; ++g)
+        {
+            om[g] = VecD::load(Om + g * VecD::width);
+            ok[g] = VecD::load(Ok + g * VecD::width);
+            ol[g] = VecD::load(OL + g * VecD::width);
+            accC[g] = accT[g] = VecD(0.0);
+        }
+        for (int k = 1; k <= np - 1; k += 2)
+        {
+            const VecD x1(1 + (a + k * h));
+            const VecD x2 = x1 * x1, x3 = x2 * x1;
+            const VecD invX1 = one / x1;
+            for (g = 0; g < vecsPerKind; ++g)
+            {
+                VecD inv = one / sqrt(om[g] * x3 + ok[g] * x2 + ol[g]);
+                if (Which & COMOVING)
+                    accC[g] += inv;
+                if (Which & LOOKBACK)
+                    accT[g] += inv * invX1;
+            }
+        }
+        for (g = 0; g < vecsPerKind; ++g)
+        {
+            if (Which & COMOVING)
+                accC[g].store(s + g * VecD::width);
+            if (Which & LOOKBACK)
+                accT[g].store(s + (M - B) + g * VecD::width);
+        }
+    }
+};
+
+// orders indices by the redshift they refer to
+struct RedshiftOrder
+{
+    const double* z;
+    RedshiftOrder(const double* zs) : z(zs) {}
+    bool operator()(const size_t a, const size_t b) const { return z[a] < z[b]; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // private member functions for class Cosmo
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,7 +262,25 @@ void Cosmo::init(const double hNought, const double omegaMatter,
         Omegak_ = 0;
     q0_ = 0.5 * OmegaM_ - OmegaL_;
     dH_ = c / H0_;
-    age_ = romberg(&Cosmo::ageIntegrand, 0.0, 1.0-numeric_limits<double>::epsilon()) / H0_ * kmPerMpc;
+    flatLambda_ = !Omegak_ && OmegaM_ > 0 && OmegaL_ > 0;
+    if (flatLambda_)
+    {
+        // with s^3 = OmegaL/OmegaM and u = (1+z)/s the comoving integral
+        // becomes the elliptic integral of du / sqrt(u^3 + 1) from 1/s
+        double s = cbrt(OmegaL_ / OmegaM_);
+        cfNorm_ = 2 / sqrt(OmegaM_ * s);
+        cfInvS_ = 1 / s;
+        cfY_ = cfInvS_;
+        cfY1_ = sqrt(cfY_ + 1);
+        cfY2_ = sqrt(complex<double>(cfY_ - 0.5, -sqrt(3.0) / 2));
+        cfEta_ = sqrt(SQR(cfY_) - cfY_ + 1);
+        // the time since the big bang is cfT_ * asinh(cfA_ / (1+z)^1.5)
+        cfA_ = sqrt(OmegaL_ / OmegaM_);
+        cfT_ = 2 / (3 * sqrt(OmegaL_));
+    }
+    tableValid_ = false;
+    if (interpolate_)
+        buildTables();
     dC_ = 0;
     dM_ = 0;
     dA_ = 0;
@@ -67,53 +290,42 @@ void Cosmo::init(const double hNought, const double omegaMatter,
     z_ = 0;
     scale_ = 0;
     rhoCrit_ = 0;
+    valid_ = 0;
+    known_ = 0;
 }
 
 // Integrand for computing the age of the universe. Uses a change of
 // variables z = x / (1-x) so that integration from 0->Inf becomes an
 // integration from 0->1.
-double Cosmo::ageIntegrand(const double x)
+double Cosmo::ageIntegrand(const double x) const
 {
 	double z = x / (1 - x);
 	return 1.0 / (1 + z) / E(z) / SQR(1 - x);
 }
 
-// Romberg integration
-double Cosmo::romberg(PFD func, double a, double b)
-{
-    double h = b - a;     // coarsest panel size
-    double dR;			  // convergence
-    int np = 1;           // Current number of panels
-    const int N = 25;     // maximum iterations
-    double prec = 1e-8;	  // desired precision
-    vector<double> R(N*N);
-    // Compute the first term R(1,1)
-    R[0] = h/2 * ((this->*func)(a) + (this->*func)(b));
-    
-    // Loop over the desired number of rows, i = 2,...,N
-    int i,j,k;
-    for(i = 1; i < N; ++i)
-    {
-        // Compute the summation in the recursive trapezoidal rule
-        h /= 2.0;          // Use panels half the previous size
-        np *= 2;           // Use twice as many panels
-        double sumT = 0.0;
-        for( k=1; k<=(np-1); k+=2 ) 
-            sumT += (this->*func)( a + k*h);
-        
-        // Compute Romberg table entries R(i,1), R(i,2), ..., R(i,i)
-        R[N*i] = 0.5 * R[N*(i-1)] + h * sumT;   
-        int m = 1;
-        for( j=1; j<i; ++j )
-        {
-            m *= 4;
-            R[N*i+j] = R[N*i+j-1] + (R[N*i+j-1] - R[N*(i-1)+j-1]) / (m-1);
-        }
-        dR = (j > 1) ? R[N*i+j-1] - R[N*(i-1)+(j-2)] : R[0];
-        if (fabs(dR) < prec)
-            return R[N*i+j-1];
-    }
-    return R.back();
+// integrate the scalar integrand f from a to b using the engine selected
+// with setIntegrator()
+template <class F>
+double Cosmo::integrate(F f, double a, double b) const
+{
+    if (GAUSS_KRONROD == integrator_)
+        return gaussKronrod(f, a, b);
+    return romberg(f, a, b);
+}
+
+// absolute tolerance of the integrals done in the precision of result
+static inline double tolerance(const double*) { return 1e-8; }
+static inline double tolerance(const float*) { return FLOAT_TOLERANCE; }
+
+// integrate the M components of f from a to b into result[0..M-1], in the
+// precision of result
+template <int M, class F, class T>
+void Cosmo::integrate(F f, double a, double b, T* result) const
+{
+    if (GAUSS_KRONROD == integrator_)
+        gaussKronrod<M>(f, a, b, result, tolerance(result));
+    else
+        romberg<M>(f, a, b, result, tolerance(result));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -126,6 +338,9 @@ Cosmo::Cosmo()
 	// Default values are from 2013 Planck + WMAP polarization at low
 	// multipoles, Table 2 of Planck Collaboration, "Planck 2013 results.
 	// XVI. Cosmological parameters," Astronomy & Astrophyics submitted, 2013.
+    integrator_ = ROMBERG;
+    interpolate_ = false;
+    tErr_ = 0;
     init(67.04, 0.3183, 0.6817);
 }
 
@@ -133,6 +348,9 @@ Cosmo::Cosmo()
 Cosmo::Cosmo(const double hNought, const double omegaMatter,
 	     const double omegaLambda)
 {
+    integrator_ = ROMBERG;
+    interpolate_ = false;
+    tErr_ = 0;
     init(hNought, omegaMatter, omegaLambda);
 }
 
@@ -151,47 +369,355 @@ Cosmo& Cosmo::operator=(const Cosmo& a)
     return *this;
 }
 
-// sets scale_, and the three distance measures
-void Cosmo::setDistances()
+// Dimensionless counterpart of cumulativeDistances(): sets IC[i] to
+// d_C/d_H and IT[i] to t_L*H_0 at z[i] for the n redshifts in z. The redshifts are visited in
+// increasing order and only the interval between consecutive redshifts is
+// integrated, so the cost grows with the number of redshifts plus the range
+// they cover. Redshifts with a closed form or a table entry restart the
+// running sums from their directly evaluated values. With single set the
+// intervals are integrated in float, while the running sums stay double.
+// Redshifts that are not finite get NaN and are kept out of the sorting
+// and the sums, so they do not affect the other rows.
+void Cosmo::cumulativeIntegrals(const double* z, const size_t n, double* IC,
+                                double* IT, const bool single) const
 {
-    // calculate critical density
-    rhoCrit_ = 3.0 / 8.0 / PI * SQR(H0_ / kmPerMpc) / G *
-    (OmegaL_ + CUBE(1 + z_) * OmegaM_);
-    
-    if (!z_)
+    vector<size_t> order;
+    order.reserve(n);
+    for (size_t i = 0; i < n; ++i)
     {
-        dC_ = dM_ = VC_ = dA_ = dL_ = tL_ = 0;
-        scale_ = 0;
+        if (isfinite(z[i]))
+            order.push_back(i);
+        else
+            IC[i] = IT[i] = numeric_limits<double>::quiet_NaN();
+    }
+    sort(order.begin(), order.end(), RedshiftOrder(z));
+
+    double zPrev = 0, sumC = 0, compC = 0, sumT = 0, compT = 0;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        size_t k = order[i];
+        if (z[k] != zPrev)
+        {
+            if (flatLambda_ || inTable(z[k]))
+            {
+                sumC = comovingIntegral(z[k]);
+                sumT = lookbackIntegral(z[k]);
+                compC = compT = 0;
+            }
+            else if (single)
+            {
+                float I[2];
+                integrate<2>(DistanceKernel<BOTH, float>(OmegaM_, Omegak_,
+                                                         OmegaL_),
+                             zPrev, z[k], I);
+                addCompensated(sumC, compC, I[0]);
+                addCompensated(sumT, compT, I[1]);
+            }
+            else
+            {
+                double I[2];
+                integrate<2>(DistanceKernel<BOTH>(OmegaM_, Omegak_, OmegaL_),
+                             zPrev, z[k], I);
+                addCompensated(sumC, compC, I[0]);
+                addCompensated(sumT, compT, I[1]);
+            }
+            zPrev = z[k];
+        }
+        IC[k] = sumC + compC;
+        IT[k] = sumT + compT;
+    }
+}
+
+// Fits Chebyshev series in t in [-1, 1], u = ln(1+z) mapped linearly onto t,
+// to d_C/(d_H u) and t_L H_0/u. Both tend to 1 at z = 0, so the absolute
+// error of the fit is a relative error of the distances. Each pass samples
+// the integrals at the n Chebyshev nodes and at the n-1 extrema between
+// them; the fit is accepted once it matches the extrema to within tTol_.
+// If it still does not at the largest size, the tables are not used and
+// the integrals are evaluated directly.
+void Cosmo::buildTables()
+{
+    const size_t maxSize = 1024;
+    tuMin_ = log1p(tzMin_);
+    tuMax_ = log1p(tzMax_);
+    vector<double> z, IC, IT;
+    for (size_t n = 16; n <= maxSize; n *= 2)
+    {
+        // nodes cos(pi (k+1/2)/n) first, then the extrema cos(pi k/n)
+        z.resize(2 * n - 1);
+        for (size_t k = 0; k < n; ++k)
+            z[k] = cos(PI * (k + 0.5) / n);
+        for (size_t k = 1; k < n; ++k)
+            z[n + k - 1] = cos(PI * k / n);
+        for (size_t k = 0; k < z.size(); ++k)
+            z[k] = expm1(0.5 * (tuMax_ + tuMin_ + z[k] * (tuMax_ - tuMin_)));
+        tableValid_ = false;
+        IC.resize(z.size());
+        IT.resize(z.size());
+        cumulativeIntegrals(&z[0], z.size(), &IC[0], &IT[0]);
+        for (size_t k = 0; k < z.size(); ++k)
+        {
+            double u = log1p(z[k]);
+            IC[k] = u ? IC[k] / u : 1;
+            IT[k] = u ? IT[k] / u : 1;
+        }
+
+        chebC_.assign(n, 0);
+        chebT_.assign(n, 0);
+        for (size_t j = 0; j < n; ++j)
+        {
+            for (size_t k = 0; k < n; ++k)
+            {
+                double w = cos(PI * j * (k + 0.5) / n);
+                chebC_[j] += IC[k] * w;
+                chebT_[j] += IT[k] * w;
+            }
+            chebC_[j] *= (j ? 2.0 : 1.0) / n;
+            chebT_[j] *= (j ? 2.0 : 1.0) / n;
+        }
+
+        tErr_ = 0;
+        for (size_t k = 1; k < n; ++k)
+        {
+            double t = cos(PI * k / n);
+            tErr_ = max(tErr_, fabs(chebyshevSum(chebC_, t) / IC[n + k - 1] - 1));
+            tErr_ = max(tErr_, fabs(chebyshevSum(chebT_, t) / IT[n + k - 1] - 1));
+        }
+        if (tErr_ <= tTol_)
+        {
+            tableValid_ = true;
+            return;
+        }
+    }
+    cerr << "  Interpolation tables reach only " << tErr_
+         << " relative error; evaluating directly" << endl;
+}
+
+// line-of-sight comoving distance to z in units of the Hubble distance
+double Cosmo::comovingIntegral(const double z) const
+{
+    if (inTable(z))
+    {
+        double u = log1p(z);
+        return u * chebyshevSum(chebC_, (2 * u - tuMin_ - tuMax_) / (tuMax_ - tuMin_));
+    }
+    if (flatLambda_)
+        return flatLambdaComoving(z);
+    double I;
+    integrate<1>(DistanceKernel<COMOVING>(OmegaM_, Omegak_, OmegaL_), 0, z, &I);
+    return I;
+}
+
+// Closed form of the comoving integral for flat Lambda-CDM. Integrating
+// du / sqrt((u+1)(u-w)(u-conj(w))), w = exp(i pi/3), from y to x gives
+// 2 R_F(U12^2, U13^2, U23^2) with U13 = conj(U12) (Carlson 1988, Math.
+// Comp. 51, 267). x - y = z/s is formed directly to keep full relative
+// precision at small z. For x beyond 1e100, where x^2 would soon
+// overflow, U12 and U23 are replaced by their limits for x -> infinity,
+// conj(Y2) and Y1; the part of the integral beyond x, about 2/sqrt(x), is
+// then far below the precision of a double.
+double Cosmo::flatLambdaComoving(const double z) const
+{
+    if (!z)
+        return 0;
+    if (isnan(z))
+        return z;
+    double d = z * cfInvS_;
+    double x = cfY_ + d;
+    if (x > 1e100)
+        return cfNorm_ * carlsonRF(conj(cfY2_) * conj(cfY2_), SQR(cfY1_));
+    double X1 = sqrt(x + 1);
+    complex<double> X2 = sqrt(complex<double>(x - 0.5, -sqrt(3.0) / 2));
+    double xi = sqrt(SQR(x) - x + 1);
+    complex<double> U12 = (X1 * X2 * conj(cfY2_) + cfY1_ * cfY2_ * conj(X2)) / d;
+    double U23 = (xi * cfY1_ + cfEta_ * X1) / d;
+    double I = cfNorm_ * carlsonRF(U12 * U12, SQR(U23));
+    return d < 0 ? -I : I;
+}
+
+// lookback time to z in units of the Hubble time
+double Cosmo::lookbackIntegral(const double z) const
+{
+    if (inTable(z))
+    {
+        double u = log1p(z);
+        return u * chebyshevSum(chebT_, (2 * u - tuMin_ - tuMax_) / (tuMax_ - tuMin_));
+    }
+    if (!flatLambda_)
+    {
+        double I;
+        integrate<1>(DistanceKernel<LOOKBACK>(OmegaM_, Omegak_, OmegaL_), 0, z, &I);
+        return I;
+    }
+    // asinh(a) - asinh(b) = asinh((a^2 - b^2) / (a sqrt(1+b^2) + b sqrt(1+a^2)))
+    // avoids the cancellation between the age at z=0 and the age at z
+    double b = cfA_ / sqrt(CUBE(1 + z));
+    double a2b2 = -SQR(cfA_) * expm1(-3 * log1p(z));
+    return cfT_ * asinh(a2b2 / (cfA_ * sqrt(1 + SQR(b)) + b * sqrt(1 + SQR(cfA_))));
+}
+
+// d_C/d_H and t_L*H_0 at z together. When both have to be integrated
+// numerically they share a single pass over the integrand.
+void Cosmo::distanceIntegrals(const double z, double& IC, double& IT) const
+{
+    if (flatLambda_ || inTable(z))
+    {
+        IC = comovingIntegral(z);
+        IT = lookbackIntegral(z);
         return;
     }
+    double I[2];
+    integrate<2>(DistanceKernel<BOTH>(OmegaM_, Omegak_, OmegaL_), 0, z, I);
+    IC = I[0];
+    IT = I[1];
+}
 
-    // calculate the line-of-sight comoving distance using Romberg integration
-    dC_ = dH_ * romberg(&Cosmo::inverseOfE, 0, z_);
-    
-    // calculate everything else from the comoving distance
+// current age of the Universe in units of the Hubble time
+double Cosmo::ageIntegral() const
+{
+    if (flatLambda_)
+        return cfT_ * asinh(cfA_);
+    // the integrand behaves as sqrt(1-x) at x = 1, which tanh-sinh
+    // handles without stopping short of the endpoint
+    return tanhSinh([this](const double x) { return ageIntegrand(x); }, 0.0, 1.0);
+}
+
+// critical density (g cm**-3) at redshift z
+double Cosmo::criticalDensity(const double z) const
+{
+    return 3.0 / 8.0 / PI * SQR(H0_ / kmPerMpc) / G *
+        (OmegaL_ + CUBE(1 + z) * OmegaM_);
+}
+
+// comoving transverse distance (Mpc) for the line-of-sight distance dC
+double Cosmo::transverseDistance(const double dC) const
+{
     if (Omegak_ > 0)
+        return dH_ / sqrt(Omegak_) * sinh(sqrt(Omegak_) * dC / dH_);
+    else if (Omegak_ < 0)
+        return dH_ / sqrt(fabs(Omegak_)) * sin(sqrt(fabs(Omegak_)) * dC / dH_);
+    return dC;
+}
+
+// comoving volume (Gpc**3) out to the transverse distance dM. For small
+// w = Omega_k (dM/d_H)^2 the closed forms below lose about log10(1/w)
+// digits to cancellation, so there the series in w, 4 pi dM^3/3 (1 -
+// 3w/10 + 9w^2/56 - ...), is summed instead; 12 terms reach 1e-24.
+double Cosmo::comovingVolume(const double dM) const
+{
+    double w = Omegak_ * SQR(dM / dH_);
+    if (fabs(w) < 1e-2)
     {
-        dM_ = dH_ / sqrt(Omegak_) * sinh(sqrt(Omegak_) * dC_ / dH_);
-        VC_ = 2 * PI * CUBE(dH_) / Omegak_ *
-            (dM_ / dH_ * sqrt(1 + Omegak_ * SQR(dM_ / dH_)) -
-             asinh(sqrt(fabs(Omegak_)) * dM_ / dH_) / sqrt(fabs(Omegak_))) / 1e9;
+        // the coefficients are those of u sqrt(1+w) less those of asinh
+        double coef = 1, g = 1, sum = 0, p = 1;
+        for (int n = 1; n <= 12; ++n)
+        {
+            coef *= (1.5 - n) / n;
+            g *= -(2.0 * n - 1) / (2 * n);
+            sum += (coef - g / (2 * n + 1)) * p;
+            p *= w;
+        }
+        return 2 * PI * CUBE(dM) * sum / 1e9;
     }
+    if (Omegak_ > 0)
+        return 2 * PI * CUBE(dH_) / Omegak_ *
+            (dM / dH_ * sqrt(1 + Omegak_ * SQR(dM / dH_)) -
+             asinh(sqrt(fabs(Omegak_)) * dM / dH_) / sqrt(fabs(Omegak_))) / 1e9;
     else if (Omegak_ < 0)
+        return 2 * PI * CUBE(dH_) / Omegak_ *
+            (dM / dH_ * sqrt(1 + Omegak_ * SQR(dM / dH_)) -
+             asin(sqrt(fabs(Omegak_)) * dM / dH_) / sqrt(fabs(Omegak_))) / 1e9;
+    return 4 * PI * CUBE(dM) / 3 / 1e9;
+}
+
+// Computes the quantities in the bit mask into d. Those they are derived
+// from (the comoving distances for everything but the lookback time and
+// the critical density) must either be in the mask or already be set in d.
+// The dimensionless integrals IC = d_C/d_H and IT = t_L*H_0 are only
+// computed if their D_C or T_L bit is not yet set in known, and are then
+// added to it.
+void Cosmo::derive(Distances& d, unsigned mask, double& IC, double& IT,
+                   unsigned& known) const
+{
+    // calculate critical density
+    if (mask & RHO_CRIT)
+        d.rhoCrit = criticalDensity(d.z);
+
+    if (!d.z)
     {
-        dM_ = dH_ / sqrt(fabs(Omegak_)) * sin(sqrt(fabs(Omegak_)) * dC_ / dH_);
-        VC_ = 2 * PI * CUBE(dH_) / Omegak_ *
-            (dM_ / dH_ * sqrt(1 + Omegak_ * SQR(dM_ / dH_)) -
-             asin(sqrt(fabs(Omegak_)) * dM_ / dH_) / sqrt(fabs(Omegak_))) / 1e9;
+        d.dC = d.dM = d.VC = d.dA = d.dL = d.tL = 0;
+        d.scale = 0;
+        IC = IT = 0;
+        known |= D_C | T_L;
+        return;
     }
-    else
+
+    // integrate for the line-of-sight comoving distance and the lookback
+    // time, in a single pass when both are needed
+    unsigned missing = mask & (D_C | T_L) & ~known;
+    if ((missing & D_C) && (missing & T_L))
+        distanceIntegrals(d.z, IC, IT);
+    else if (missing & D_C)
+        IC = comovingIntegral(d.z);
+    else if (missing & T_L)
+        IT = lookbackIntegral(d.z);
+    known |= missing;
+    if (mask & D_C)
+        d.dC = dH_ * IC;
+    if (mask & T_L)
+        d.tL = IT / H0_ * kmPerMpc;
+
+    // calculate everything else from the comoving distance
+    if (mask & D_M)
+        d.dM = transverseDistance(d.dC);
+    if (mask & V_C)
+        d.VC = comovingVolume(d.dM);
+    if (mask & (D_A | SCALE))
+        d.dA = d.dM / (1 + d.z);
+    if (mask & D_L)
+        d.dL = d.dM * (1 + d.z);
+    if (mask & SCALE)
+        d.scale = d.dA / 648 * PI;
+}
+
+// Computes the quantities in the bit mask need that are not valid yet,
+// together with the ones they are derived from, and marks them valid.
+// Everything else is left for a later call.
+void Cosmo::require(unsigned need)
+{
+    if (need & (D_A | D_L | SCALE | V_C))
+        need |= D_M;
+    if (need & D_M)
+        need |= D_C;
+    unsigned missing = need & ~valid_;
+    if (!missing)
+        return;
+
+    // the age of the Universe is the most expensive integral, so it is
+    // only done for callers that ask for it
+    if (missing & AGE)
+    {
+        if (!(known_ & AGE))
+            IA_ = ageIntegral();
+        known_ |= AGE;
+        age_ = IA_ / H0_ * kmPerMpc;
+    }
+
+    if (missing & ~AGE)
     {
-        dM_ = dC_;
-        VC_ = 4 * PI * CUBE(dM_) / 3 / 1e9;
+        Distances d = { z_, dA_, dL_, dC_, dM_, VC_, tL_, scale_, rhoCrit_ };
+        derive(d, missing, IC_, IT_, known_);
+        dA_ = d.dA;
+        dL_ = d.dL;
+        dC_ = d.dC;
+        dM_ = d.dM;
+        VC_ = d.VC;
+        tL_ = d.tL;
+        scale_ = d.scale;
+        rhoCrit_ = d.rhoCrit;
     }
-    dA_ = dM_ / (1 + z_);
-    dL_ = dM_ * (1 + z_);
-    tL_ = romberg(&Cosmo::lookbackIntegrand, 0, z_) / H0_ * kmPerMpc;
-    scale_ = dA_ / 648 * PI;
+    // d_A comes along with the scale
+    valid_ |= missing | (missing & SCALE ? D_A : 0);
 }
 
 // print info about the cosmology to the given ostream (default stream is STDOUT)
@@ -224,6 +750,7 @@ void Cosmo::printParamsAsHtml(ostream& os = cout, const char* leader = "")
 // print a verbose summary of all the member data to STDOUT
 void Cosmo::printLong()
 {
+    require(ALL);
     printParams();
     cout << setprecision(6)
          << "At z = " << z_ << "\n"
@@ -247,6 +774,7 @@ void Cosmo::printLong()
 // print a verbose summary of all the member data to STDOUT
 void Cosmo::printAsHtml()
 {
+    require(ALL);
     cout << "<p>";
     printParamsAsHtml();
     cout << "<br />";
@@ -283,24 +811,344 @@ void Cosmo::printShortHeader(ostream & os = cout)
 // default stream is STDOUT
 void Cosmo::printShort(ostream & os = cout)
 {
-    os << setprecision(6)
-       << z_ << "\t" << dA_ << "\t" << dL_ << "\t" << dC_ << "\t" << scale_ << "\t"
-       << 1/scale_ << "\t" << tL_ / tropicalYear / 1e9 << endl;
+    require(D_A | D_L | D_C | SCALE | T_L);
+    Distances d = { z_, dA_, dL_, dC_, dM_, VC_, tL_, scale_, rhoCrit_ };
+    printShort(os, d);
+}
+
+// print (to an ostream) the distances d, as returned by evaluate() with at
+// least D_A | D_L | D_C | SCALE | T_L, on a single line. The stream is not
+// flushed.
+void Cosmo::printShort(ostream & os, const Distances& d) const
+{
+    char line[SHORT_LINE_MAX];
+    os.write(line, formatShort(line, d) - line);
+}
+
+// Writes the line of printShort() for d to p, which must have room for
+// SHORT_LINE_MAX chars, and returns the end of the line. The numbers are
+// formatted with std::to_chars like "%.<digits>g", so the default of 6
+// digits gives the same text as the stream output of earlier versions;
+// with digits = 0 they take the fewest digits that read back exactly.
+char* Cosmo::formatShort(char* p, const Distances& d, int digits) const
+{
+    const double v[7] = { d.z, d.dA, d.dL, d.dC, d.scale, 1/d.scale,
+                          d.tL / tropicalYear / 1e9 };
+    digits = min(max(digits, 0), 17);
+    for (int i = 0; i < 7; ++i)
+    {
+        // 32 chars hold any double, e.g. -1.2345678901234567e+308
+        to_chars_result r = digits
+            ? to_chars(p, p + 32, v[i], chars_format::general, digits)
+            : to_chars(p, p + 32, v[i]);
+        p = r.ptr;
+        *p++ = i < 6 ? '\t' : '\n';
+    }
+    return p;
+}
+
+// Returns the quantities selected by mask at redshift z; the others are
+// zero. Unlike setRedshift() and the accessors this changes nothing in the
+// object, so a single Cosmo may be shared by any number of threads calling
+// evaluate() as long as none of them changes it.
+Distances Cosmo::evaluate(const double z, QuantityMask mask) const noexcept
+{
+    if (mask & (D_A | D_L | SCALE | V_C))
+        mask |= D_M;
+    if (mask & D_M)
+        mask |= D_C;
+    Distances d = { z, 0, 0, 0, 0, 0, 0, 0, 0 };
+    double IC, IT;
+    unsigned known = 0;
+    derive(d, mask, IC, IT, known);
+    return d;
+}
+
+// Returns in out the quantities selected by mask at redshift z for each
+// cosmology in params, as evaluate() would. Flat Lambda-CDM cosmologies use
+// their closed forms. The others are integrated in blocks of
+// ENSEMBLE_BLOCK, with the cosmologies of a block in the lanes of the SIMD
+// kernel, and all of them must converge before the block is done.
+void Cosmo::evaluateEnsemble(const vector<CosmoParams>& params, const double z,
+                             vector<Distances>& out, QuantityMask mask,
+                             const Integrator engine)
+{
+    const int B = ENSEMBLE_BLOCK;
+    if (mask & (D_A | D_L | SCALE | V_C))
+        mask |= D_M;
+    if (mask & D_M)
+        mask |= D_C;
+    const unsigned which = mask & (D_C | T_L);
+    out.resize(params.size());
+
+    vector<Cosmo> cosmos;
+    cosmos.reserve(params.size());
+    vector<size_t> open;   // cosmologies without a closed form
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        cosmos.push_back(Cosmo(params[i].H0, params[i].OmegaM, params[i].OmegaL));
+        cosmos[i].integrator_ = engine;
+        if (z && which && !cosmos[i].flatLambda_)
+            open.push_back(i);
+        else
+            out[i] = cosmos[i].evaluate(z, mask);
+    }
+
+    for (size_t first = 0; first < open.size(); first += B)
+    {
+        // pad the last block with copies of its last cosmology
+        EnsembleKernel<BOTH, B> both;
+        EnsembleKernel<COMOVING, B> comoving;
+        EnsembleKernel<LOOKBACK, B> lookback;
+        for (int l = 0; l < B; ++l)
+        {
+            const Cosmo& cosmo = cosmos[open[min(first + l, open.size() - 1)]];
+            both.Om[l] = comoving.Om[l] = lookback.Om[l] = cosmo.OmegaM_;
+            both.Ok[l] = comoving.Ok[l] = lookback.Ok[l] = cosmo.Omegak_;
+            both.OL[l] = comoving.OL[l] = lookback.OL[l] = cosmo.OmegaL_;
+        }
+        double I[2 * B] = { 0 };
+        const Cosmo& cosmo = cosmos[open[first]];
+        if ((D_C | T_L) == which)
+            cosmo.integrate<2 * B>(both, 0, z, I);
+        else if (D_C == which)
+            cosmo.integrate<B>(comoving, 0, z, I);
+        else
+            cosmo.integrate<B>(lookback, 0, z, I + B);
+
+        for (int l = 0; l < B && first + l < open.size(); ++l)
+        {
+            size_t i = open[first + l];
+            Distances d = { z, 0, 0, 0, 0, 0, 0, 0, 0 };
+            unsigned known = D_C | T_L;
+            cosmos[i].derive(d, mask, I[l], I[B + l], known);
+            out[i] = d;
+        }
+    }
+}
+
+// Computes the comoving distance (Mpc) and lookback time (sec) to every
+// redshift in z and returns them in dC and tL in the order of z. Does not
+// change z_.
+void Cosmo::cumulativeDistances(const vector<double>& z, vector<double>& dC,
+                                vector<double>& tL) const
+{
+    dC.resize(z.size());
+    tL.resize(z.size());
+    if (z.empty())
+        return;
+    cumulativeIntegrals(&z[0], z.size(), &dC[0], &tL[0]);
+    double tH = kmPerMpc / H0_; // Hubble time in seconds
+    for (size_t i = 0; i < z.size(); ++i)
+    {
+        dC[i] *= dH_;
+        tL[i] *= tH;
+    }
+}
+
+// Selects Chebyshev interpolation of the comoving distance and lookback
+// time for zMin <= z <= zMax. The tables are fitted now and again on every
+// change of cosmology, doubling their size until the relative error
+// checked between the interpolation nodes is below relErr. If 1024
+// coefficients do not reach relErr the tables are not used; interpolating()
+// tells whether they are.
+void Cosmo::setInterpolation(const double zMin, const double zMax,
+                             const double relErr)
+{
+    if (zMin <= -1 || zMax <= zMin)
+    {
+        cerr << "  Interpolation range must satisfy -1 < zMin < zMax" << endl;
+        return;
+    }
+    if (!(relErr > 0))
+    {
+        cerr << "  Interpolation error must be positive" << endl;
+        return;
+    }
+    interpolate_ = true;
+    tzMin_ = zMin;
+    tzMax_ = zMax;
+    tTol_ = relErr;
+    double z = z_;
+    init(H0_, OmegaM_, OmegaL_);
+    setRedshift(z);
+}
+
+// returns to direct evaluation of the integrals
+void Cosmo::clearInterpolation()
+{
+    interpolate_ = tableValid_ = false;
+    chebC_.clear();
+    chebT_.clear();
+    tErr_ = 0;
+    valid_ &= AGE;
+    known_ &= AGE;
+}
+
+// the columns computeBatch() fills for mask: the selected ones plus the
+// intermediate ones they are derived from
+static QuantityMask batchColumns(const QuantityMask mask)
+{
+    QuantityMask need = mask;
+    if (need & Cosmo::SCALE)
+        need |= Cosmo::D_A;
+    if (need & (Cosmo::D_A | Cosmo::D_L | Cosmo::V_C))
+        need |= Cosmo::D_M;
+    if (need & Cosmo::D_M)
+        need |= Cosmo::D_C;
+    return need;
+}
+
+// sizes the columns of out for n rows, emptying those not in need
+template <class Real>
+static void sizeColumns(DistanceColumnsOf<Real>& out, const size_t n,
+                        const QuantityMask need)
+{
+    out.dC.assign(need & Cosmo::D_C ? n : 0, 0);
+    out.dM.assign(need & Cosmo::D_M ? n : 0, 0);
+    out.VC.assign(need & Cosmo::V_C ? n : 0, 0);
+    out.dA.assign(need & Cosmo::D_A ? n : 0, 0);
+    out.dL.assign(need & Cosmo::D_L ? n : 0, 0);
+    out.tL.assign(need & Cosmo::T_L ? n : 0, 0);
+    out.scale.assign(need & Cosmo::SCALE ? n : 0, 0);
+    out.rhoCrit.assign(need & Cosmo::RHO_CRIT ? n : 0, 0);
+}
+
+// drops the intermediate columns nobody asked for
+template <class Real>
+static void dropColumns(DistanceColumnsOf<Real>& out, const QuantityMask mask)
+{
+    if (!(mask & Cosmo::D_C))
+        out.dC.clear();
+    if (!(mask & Cosmo::D_M))
+        out.dM.clear();
+    if (!(mask & Cosmo::D_A))
+        out.dA.clear();
+}
+
+// Computes the quantities selected by mask for the n redshifts in z and
+// stores them in the matching columns of out, in the order of z. Columns
+// that are not selected are emptied. The integrals are done once for the
+// whole batch as in cumulativeDistances(). Does not change z_.
+void Cosmo::computeBatch(const double* z, const size_t n, DistanceColumns& out,
+                         QuantityMask mask) const
+{
+    sizeColumns(out, n, batchColumns(mask));
+    batchRange(z, 0, n, out, mask);
+    dropColumns(out, mask);
+}
+
+// As above, but the rows are split into chunks that the scheduler runs in
+// parallel, all of them on this object. The integrals are done once per
+// chunk.
+void Cosmo::computeBatch(const double* z, const size_t n, DistanceColumns& out,
+                         Scheduler& scheduler, QuantityMask mask) const
+{
+    sizeColumns(out, n, batchColumns(mask));
+    scheduler.run(n, [&](size_t begin, size_t end, int)
+                  { batchRange(z, begin, end, out, mask); });
+    dropColumns(out, mask);
+}
+
+// Float32 mode of the two above: the intervals between redshifts are
+// integrated in single precision, twice as many abscissae per SIMD
+// instruction, to FLOAT_TOLERANCE rather than 1e-8, and the columns are
+// floats, halving the memory they take. The running sums, closed forms and
+// tables stay double and every row is derived in double, so the errors are
+// those of the integration and of the final rounding to float: within 1e-6
+// of the double results for 0 <= z <= 20, as float_test checks.
+void Cosmo::computeBatch(const double* z, const size_t n,
+                         DistanceColumns32& out, QuantityMask mask) const
+{
+    sizeColumns(out, n, batchColumns(mask));
+    batchRange(z, 0, n, out, mask);
+    dropColumns(out, mask);
+}
+
+void Cosmo::computeBatch(const double* z, const size_t n,
+                         DistanceColumns32& out, Scheduler& scheduler,
+                         QuantityMask mask) const
+{
+    sizeColumns(out, n, batchColumns(mask));
+    scheduler.run(n, [&](size_t begin, size_t end, int)
+                  { batchRange(z, begin, end, out, mask); });
+    dropColumns(out, mask);
+}
+
+// Fills rows [begin, end) of the columns of out, which sizeColumns() has
+// already sized for the whole batch. Each row is derived in double and only
+// rounded to Real when it is stored.
+template <class Real>
+void Cosmo::batchRange(const double* z, const size_t begin, const size_t end,
+                       DistanceColumnsOf<Real>& out, QuantityMask mask) const
+{
+    QuantityMask need = batchColumns(mask);
+    size_t n = end - begin;
+    vector<double> IC, IT;
+    if (n && (need & (D_C | T_L)))
+    {
+        IC.resize(n);
+        IT.resize(n);
+        cumulativeIntegrals(z + begin, n, &IC[0], &IT[0],
+                            sizeof(Real) < sizeof(double));
+    }
+    double tH = kmPerMpc / H0_; // Hubble time in seconds
+    for (size_t i = begin; i < end; ++i)
+    {
+        double dC = 0, dM = 0, dA = 0;
+        if (need & D_C)
+            out.dC[i] = dC = dH_ * IC[i - begin];
+        if (mask & T_L)
+            out.tL[i] = tH * IT[i - begin];
+        if (need & D_M)
+            out.dM[i] = dM = transverseDistance(dC);
+        if (mask & V_C)
+            out.VC[i] = comovingVolume(dM);
+        if (need & D_A)
+            out.dA[i] = dA = dM / (1 + z[i]);
+        if (mask & D_L)
+            out.dL[i] = dM * (1 + z[i]);
+        if (mask & SCALE)
+            out.scale[i] = dA / 648 * PI;
+        if (mask & RHO_CRIT)
+            out.rhoCrit[i] = criticalDensity(z[i]);
+    }
 }
 
 // set the cosmological parameters and the secondary stuff derived from them
 void Cosmo::setCosmology(const double hNought, const double omegaMatter,
 			 const double omegaLambda)
 {
+    if (omegaMatter == OmegaM_ && omegaLambda == OmegaL_)
+    {
+        // only the Hubble constant changes: the dimensionless integrals
+        // and tables stay valid and the quantities are rescaled from them
+        H0_ = hNought;
+        dH_ = c / H0_;
+        valid_ = 0;
+        return;
+    }
+    double z = z_;
     init(hNought, omegaMatter, omegaLambda);
-    if (z_) setDistances();
+    setRedshift(z);
 }
 
-// set z_ using user input, then set the things that depend on z_
+// set z_ using user input; the things that depend on z_ are computed
+// when they are first asked for
 void Cosmo::setRedshift(const double redshift)
 {
     z_ = redshift;
-    setDistances();
+    valid_ &= AGE;
+    known_ &= AGE;
+}
+
+// select the integration engine and recompute everything derived from it
+void Cosmo::setIntegrator(const Integrator engine)
+{
+    double z = z_;
+    integrator_ = engine;
+    init(H0_, OmegaM_, OmegaL_);
+    setRedshift(z);
 }
 
 // prompt the user for the cosmological parameters
@@ -312,7 +1160,7 @@ void Cosmo::getCosmologyFromUser()
     while ((OmegaM_tmp = promptForParam("Omega matter", OmegaM_)) < 0)
         cerr << "  Omega matter must be >= 0" << endl;
     OmegaL_tmp = promptForParam("Omega lambda", OmegaL_);
-    init(H0_tmp, OmegaM_tmp, OmegaL_tmp);
+    setCosmology(H0_tmp, OmegaM_tmp, OmegaL_tmp);
 }
 
 
@@ -365,3 +1213,152 @@ double promptForParam(const char* description, const double defaultVal)
     return defaultVal;
 }
 
+
+// Finds the distinct values among the n redshifts in z, which are compared
+// by their bit patterns through a hash table. unique receives them in the
+// order of their first appearance and index[i] the position of z[i] in
+// unique, so results computed once per distinct redshift can be fanned
+// out with unique[index[i]]. Returns the number of distinct redshifts.
+size_t uniqueRedshifts(const double* z, const size_t n, vector<double>& unique,
+                       vector<size_t>& index)
+{
+    unordered_map<uint64_t, size_t> seen(2 * n);
+    unique.clear();
+    index.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint64_t bits;
+        memcpy(&bits, &z[i], sizeof(bits));
+        pair<unordered_map<uint64_t, size_t>::iterator, bool> found =
+            seen.insert(make_pair(bits, unique.size()));
+        if (found.second)
+            unique.push_back(z[i]);
+        index[i] = found.first->second;
+    }
+    return unique.size();
+}
+
+// the column of out that computeBatch() fills for the Quantity bit q
+static const vector<double>& batchColumn(const DistanceColumns& out,
+                                         const QuantityMask q)
+{
+    switch (q)
+    {
+    case Cosmo::RHO_CRIT: return out.rhoCrit;
+    case Cosmo::D_C: return out.dC;
+    case Cosmo::D_M: return out.dM;
+    case Cosmo::V_C: return out.VC;
+    case Cosmo::D_A: return out.dA;
+    case Cosmo::D_L: return out.dL;
+    case Cosmo::T_L: return out.tL;
+    default: return out.scale;
+    }
+}
+
+// Evaluates the quantities selected by mask at every redshift in z for
+// every cosmology in params and stores them in cube, one slot per selected
+// quantity in the order of the Cosmo::Quantity bits. The age is only
+// integrated if mask includes Cosmo::AGE.
+void sweepGrid(const vector<CosmoParams>& params, const vector<double>& z,
+               QuantityMask mask, GridCube& cube)
+{
+    Scheduler serial(1);
+    sweepGrid(params, z, mask, cube, serial);
+}
+
+// power of H_0 with which the Quantity q scales at fixed OmegaM and OmegaL
+static int hubblePower(const QuantityMask q)
+{
+    if (Cosmo::RHO_CRIT == q)
+        return 2;
+    if (Cosmo::V_C == q)
+        return -3;
+    return -1;  // distances, times and the scale
+}
+
+// orders the indices of cosmologies by OmegaM, then OmegaL, so that those
+// differing only in H0 are next to each other
+struct DensityOrder
+{
+    const vector<CosmoParams>& p;
+    DensityOrder(const vector<CosmoParams>& params) : p(params) {}
+    bool operator()(const size_t a, const size_t b) const
+    {
+        if (p[a].OmegaM != p[b].OmegaM)
+            return p[a].OmegaM < p[b].OmegaM;
+        return p[a].OmegaL < p[b].OmegaL;
+    }
+};
+
+// As above, with the cosmologies run in parallel by the scheduler. The
+// cosmologies are sorted by OmegaM and OmegaL and split into groups that
+// differ only in H0; the scheduler runs over the groups. The first of each
+// group does its integrals once for all of z, as in computeBatch(), and the
+// others rescale its results, so the cube does not depend on how the groups
+// are spread over the threads.
+void sweepGrid(const vector<CosmoParams>& params, const vector<double>& z,
+               QuantityMask mask, GridCube& cube, Scheduler& scheduler)
+{
+    cube.nCosmo = params.size();
+    cube.nZ = z.size();
+    cube.quantities.clear();
+    for (QuantityMask q = 1; q < Cosmo::AGE; q <<= 1)
+        if (mask & q)
+            cube.quantities.push_back(q);
+    const size_t nQ = cube.quantities.size();
+    const size_t slice = cube.nZ * nQ;
+    cube.values.assign(cube.nCosmo * slice, 0.0);
+    cube.age.assign(mask & Cosmo::AGE ? cube.nCosmo : 0, 0.0);
+
+    vector<size_t> order(params.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(), DensityOrder(params));
+    // offsets in order of the first cosmology of each group, and the end
+    vector<size_t> groups;
+    for (size_t n = 0; n < order.size(); ++n)
+        if (!n || params[order[n-1]].OmegaM != params[order[n]].OmegaM
+            || params[order[n-1]].OmegaL != params[order[n]].OmegaL)
+            groups.push_back(n);
+    groups.push_back(order.size());
+
+    vector<DistanceColumns> columns(scheduler.threads());
+    scheduler.run(groups.size() - 1, [&](size_t begin, size_t end, int t)
+    {
+        for (size_t g = begin; g < end; ++g)
+        {
+            size_t first = order[groups[g]];
+            double* base = cube.values.data() + first * slice;
+            Cosmo c(params[first].H0, params[first].OmegaM,
+                    params[first].OmegaL);
+            if (nQ && cube.nZ)
+            {
+                c.computeBatch(&z[0], z.size(), columns[t], mask & ~Cosmo::AGE);
+                for (size_t k = 0; k < nQ; ++k)
+                {
+                    const vector<double>& col =
+                        batchColumn(columns[t], cube.quantities[k]);
+                    for (size_t j = 0; j < cube.nZ; ++j)
+                        base[j * nQ + k] = col[j];
+                }
+            }
+            if (mask & Cosmo::AGE)
+                cube.age[first] = c.age();
+
+            for (size_t n = groups[g] + 1; n < groups[g + 1]; ++n)
+            {
+                size_t i = order[n];
+                double* out = cube.values.data() + i * slice;
+                double r = params[i].H0 / params[first].H0;
+                for (size_t k = 0; slice && k < nQ; ++k)
+                {
+                    double f = pow(r, hubblePower(cube.quantities[k]));
+                    for (size_t j = 0; j < cube.nZ; ++j)
+                        out[j * nQ + k] = f * base[j * nQ + k];
+                }
+                if (mask & Cosmo::AGE)
+                    cube.age[i] = cube.age[first] / r;
+            }
+        }
+    });
+}
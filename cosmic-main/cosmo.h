@@ -2,7 +2,7 @@
 Header file for a cosmology library of general use in observational astronomy
 Copyright (C) 2003-2021  Joshua Kempner
 
-Version 2.1.5
+Version 2.2
 
 This program is free software; you can redistribute it and/or
 modify it under the terms of the GNU General Public License
@@ -29,14 +29,82 @@ josh@kempner.net.
 #include <fstream>
 #include <vector>
 #include <cmath>
+#include <complex>
+
+#include "scheduler.h"
 
 using namespace std;
 
+// bitwise OR of Cosmo::Quantity values selecting what to compute
+typedef unsigned QuantityMask;
+
+// Structure-of-arrays output of Cosmo::computeBatch(): one column per
+// quantity, in the units of the corresponding accessors of Cosmo
+template <class Real>
+struct DistanceColumnsOf
+{
+    vector<Real> dA, dL, dC, dM;    // distances (Mpc)
+    vector<Real> VC;                // comoving volume (Gpc**3)
+    vector<Real> tL;                // lookback time (sec)
+    vector<Real> scale;             // kpc/"
+    vector<Real> rhoCrit;           // critical density (g cm**-3)
+};
+typedef DistanceColumnsOf<double> DistanceColumns;
+// single precision, for computeBatch() in float32 mode
+typedef DistanceColumnsOf<float> DistanceColumns32;
+
+// Cosmological parameters of one point of a grid for sweepGrid()
+struct CosmoParams
+{
+    double H0, OmegaM, OmegaL;
+};
+
+// Dense result of sweepGrid(): values[(i*nZ + j)*quantities.size() + k] is
+// quantity k at redshift j in cosmology i, in the units of the
+// corresponding accessors of Cosmo. The age, which depends only on the
+// cosmology, is kept apart.
+struct GridCube
+{
+    size_t nCosmo, nZ;
+    vector<QuantityMask> quantities; // Cosmo::Quantity bit of each slot
+    vector<double> values;           // [cosmology][z][quantity]
+    vector<double> age;              // [cosmology] (sec), if requested
+    inline double at(const size_t i, const size_t j, const size_t k) const
+    {
+        return values[(i * nZ + j) * quantities.size() + k];
+    }
+};
+
+// Quantities derived from a redshift, as returned by Cosmo::evaluate(), in
+// the units of the corresponding accessors of Cosmo
+struct Distances
+{
+    double z;                 // redshift of source
+    double dA, dL, dC, dM;    // distances (Mpc)
+    double VC;                // comoving volume (Gpc**3)
+    double tL;                // lookback time (sec)
+    double scale;             // kpc/"
+    double rhoCrit;           // critical density (g cm**-3)
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Class to implement the cosmology
 ////////////////////////////////////////////////////////////////////////////////
 class Cosmo
 {
+public:
+    // numerical integration engines available for the distance integrals
+    enum Integrator { ROMBERG, GAUSS_KRONROD };
+    // bits naming the quantities derived from the redshift, and the age,
+    // which depends only on the cosmology
+    enum Quantity { RHO_CRIT = 1, D_C = 2, D_M = 4, V_C = 8, D_A = 16,
+                    D_L = 32, T_L = 64, SCALE = 128, AGE = 256, ALL = 511 };
+    // cosmologies integrated together by evaluateEnsemble()
+    enum { ENSEMBLE_BLOCK = 8 };
+    // room needed for a line of formatShort()
+    enum { SHORT_LINE_MAX = 256 };
+
+private:
     // cosmological parameters
     double H0_, q0_;      // Hubble constant at z=0, q_0
     double OmegaM_, OmegaL_, Omegak_; // scaled densities of matter, vacuum energy,
@@ -54,26 +122,83 @@ class Cosmo
     double age_;		// Current age of the Universe in seconds
     double scale_;        // kpc/" at redshift of source
     double rhoCrit_;	// Critical density at redshift of source
+    unsigned valid_;      // Quantity bits of the members above that are current
+    // dimensionless integrals, which depend on OmegaM_ and OmegaL_ but not
+    // on H0_, so that changing only H0_ merely rescales them
+    double IC_, IT_;      // d_C / d_H and t_L * H_0 at z_
+    double IA_;           // age * H_0
+    unsigned known_;      // D_C, T_L and AGE bits of the integrals that are current
+    Integrator integrator_; // engine used by integrate()
+    // constants of the closed-form comoving distance in flat Lambda-CDM
+    bool flatLambda_;     // Omegak_ == 0 and OmegaM_, OmegaL_ > 0
+    double cfNorm_, cfInvS_, cfY_, cfY1_, cfEta_;
+    complex<double> cfY2_;
+    double cfA_, cfT_;    // sqrt(OmegaL/OmegaM), 2/(3 sqrt(OmegaL)) for times
+    // optional Chebyshev interpolants of d_C/d_H and t_L*H_0 in u = ln(1+z)
+    bool interpolate_;    // rebuild the tables whenever the cosmology changes
+    bool tableValid_;     // tables are built and may be used
+    double tzMin_, tzMax_, tuMin_, tuMax_; // redshift and u range of the tables
+    double tTol_, tErr_;  // requested and achieved relative error
+    vector<double> chebC_, chebT_; // coefficients for d_C/(d_H u) and t_L H_0/u
 
     // private member functions
     void init(const double, const double, const double);// NOT exclusive to constructors
     inline void clone(const Cosmo& a) // used in copy constructor and in assignment
     {
+        integrator_ = a.integrator_;
+        interpolate_ = false;  // copy the tables instead of rebuilding them
         init(a.H0_, a.OmegaM_, a.OmegaL_);
+        interpolate_ = a.interpolate_;
+        tableValid_ = a.tableValid_;
+        tzMin_ = a.tzMin_;
+        tzMax_ = a.tzMax_;
+        tuMin_ = a.tuMin_;
+        tuMax_ = a.tuMax_;
+        tTol_ = a.tTol_;
+        tErr_ = a.tErr_;
+        chebC_ = a.chebC_;
+        chebT_ = a.chebT_;
         setRedshift(a.z_);
+        IC_ = a.IC_;
+        IT_ = a.IT_;
+        IA_ = a.IA_;
+        known_ = a.known_;
     }
-    inline double E(const double z) // calculate expansion factor at a given redshift
+    inline double E(const double z) const // calculate expansion factor at a given redshift
     {
         return sqrt(OmegaM_ * CUBE(1 + z) + Omegak_ * SQR(1 + z) + OmegaL_);
     }
-    inline double inverseOfE(const double z) { return 1.0 / E(z); }
-	inline double lookbackIntegrand(const double z) { return 1.0 / (1 + z) / E(z); }
-    double ageIntegrand(const double z);
-    typedef double (Cosmo::*PFD)(const double);
-    double romberg(PFD, double, double);
-    void setDistances(); // set the distance measures
-    inline double SQR(const double a) { return a*a; }
-    inline double CUBE(const double a) { return a*a*a; }
+    double ageIntegrand(const double z) const;
+    // dispatch to the engine in integrator_ (see integrate.h)
+    template <class F> double integrate(F, double, double) const;
+    template <int M, class F, class T> void integrate(F, double, double, T*) const;
+    double comovingIntegral(const double) const; // dimensionless d_C / d_H
+    double flatLambdaComoving(const double) const;
+    double lookbackIntegral(const double) const; // dimensionless t_L * H_0
+    double ageIntegral() const; // dimensionless age * H_0
+    void distanceIntegrals(const double, double&, double&) const; // both of the above
+    void cumulativeIntegrals(const double*, const size_t, double*, double*,
+                             bool = false) const; // dimensionless d_C and t_L
+    void buildTables();       // fit the Chebyshev interpolants
+    // fill rows [begin, end) of the presized columns of computeBatch()
+    template <class Real>
+    void batchRange(const double*, const size_t, const size_t,
+                    DistanceColumnsOf<Real>&, QuantityMask) const;
+    inline bool inTable(const double z) const
+    {
+        return tableValid_ && z >= tzMin_ && z <= tzMax_;
+    }
+    double criticalDensity(const double) const;
+    double transverseDistance(const double) const; // d_M from d_C
+    double comovingVolume(const double) const;     // V_C from d_M
+    // compute the quantities in the mask into d, given those they are
+    // derived from that are not in the mask and the dimensionless
+    // integrals whose D_C and T_L bits are set in known
+    void derive(Distances& d, unsigned, double& IC, double& IT,
+                unsigned& known) const;
+    void require(unsigned); // compute the given quantities if not yet valid
+    inline double SQR(const double a) const { return a*a; }
+    inline double CUBE(const double a) const { return a*a*a; }
 
 public:
     // constructors etc.
@@ -84,30 +209,68 @@ public:
 
     // inspection functions
     inline double z() { return z_; }    // redshift of source
-    inline double dL() { return dL_; }  // Luminosity distance (Mpc)
-    inline double dA() { return dA_; }  // Angular diameter distance (Mpc)
-    inline double dC() { return dC_; }  // Comoving line-of-sight distance (Mpc)
-    inline double dM() { return dM_; }  // Comoving transverse distance (Mpc)
-    inline double VC() { return VC_; }  // comoving volume (Gpc**3)
-    inline double lookback() { return tL_; }  // lookback time to source (sec)
-    inline double scale() { return scale_; }  // kpc/" at redshift of source
-    inline double rhoCrit() { return rhoCrit_; }  // critial density at source
-    inline double age() { return age_; }	// Current age of the Universe (sec)
+    inline double dL() { require(D_L); return dL_; }  // Luminosity distance (Mpc)
+    inline double dA() { require(D_A); return dA_; }  // Angular diameter distance (Mpc)
+    inline double dC() { require(D_C); return dC_; }  // Comoving line-of-sight distance (Mpc)
+    inline double dM() { require(D_M); return dM_; }  // Comoving transverse distance (Mpc)
+    inline double VC() { require(V_C); return VC_; }  // comoving volume (Gpc**3)
+    inline double lookback() { require(T_L); return tL_; }  // lookback time to source (sec)
+    inline double scale() { require(SCALE); return scale_; }  // kpc/" at redshift of source
+    inline double rhoCrit() { require(RHO_CRIT); return rhoCrit_; }  // critial density at source
+    inline double age() { require(AGE); return age_; }	// Current age of the Universe (sec)
+    inline Integrator integrator() { return integrator_; } // current engine
+    inline double interpolationError() { return tErr_; } // achieved rel. error
+    inline int interpolationSize() { return chebC_.size(); } // coefficients per table
+    inline bool interpolating() { return tableValid_; } // tables are in use
     void printParams(ostream&, const char*); // print cosmological parameters
     void printParamsAsHtml(ostream&, const char*); // same as printParams but formatted in HTML
     void printLong();	      // print derived quantities to STDOUT
     void printAsHtml();     // equivalent to printLong but formatted in HTML
     void printShortHeader(ostream&);  // print header line for columns in printShort()
     void printShort(ostream&);  // print distances in columns
+    void printShort(ostream&, const Distances&) const; // same for evaluate()
+    // the line of printShort() into a buffer, with the given significant
+    // digits (0 = shortest that reads back exactly); returns its end
+    char* formatShort(char*, const Distances&, int = 6) const;
+    // selected quantities at a redshift, without touching the object, so
+    // that any number of threads can share it
+    Distances evaluate(const double, QuantityMask = ALL) const noexcept;
+    // the same for many cosmologies at one redshift, integrated together
+    static void evaluateEnsemble(const vector<CosmoParams>&, const double,
+                                 vector<Distances>&, QuantityMask = ALL,
+                                 const Integrator = ROMBERG);
+    // d_C (Mpc) and t_L (sec) for many redshifts at once, in input order
+    void cumulativeDistances(const vector<double>&, vector<double>&,
+                             vector<double>&) const;
+    // selected quantities for n redshifts, one column each
+    void computeBatch(const double*, const size_t, DistanceColumns&,
+                      QuantityMask = ALL) const;
+    // the same, run in parallel by the given scheduler
+    void computeBatch(const double*, const size_t, DistanceColumns&,
+                      Scheduler&, QuantityMask = ALL) const;
+    // both of the above in float32 mode: half the column memory, to 1e-6 relative
+    void computeBatch(const double*, const size_t, DistanceColumns32&,
+                      QuantityMask = ALL) const;
+    void computeBatch(const double*, const size_t, DistanceColumns32&,
+                      Scheduler&, QuantityMask = ALL) const;
 
     // mutation functions
     void setCosmology(const double, const double, const double);
     void setRedshift(const double);
+    void setIntegrator(const Integrator);
+    void setInterpolation(const double, const double, const double);
+    void clearInterpolation();
     void getCosmologyFromUser();
 };
 
 // non-member functions
 int isNumeric(const string&);
 double promptForParam(const char*, const double);
+size_t uniqueRedshifts(const double*, const size_t, vector<double>&,
+                       vector<size_t>&);
+void sweepGrid(const vector<CosmoParams>&, const vector<double>&,
+               QuantityMask, GridCube&);
+void sweepGrid(const vector<CosmoParams>&, const vector<double>&,
+               QuantityMask, GridCube&, Scheduler&);
 
 #endif // __COSMO_H__
@@ -0,0 +1,101 @@
+/*******************************************************************************
+Test of the accuracy of the float32 mode of computeBatch()
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "cosmo.h"
+
+using namespace std;
+
+// the bound documented for the float32 mode over 0 <= z <= 20
+const double bound = 1e-6;
+
+static const char* names[] = { "rhoCrit", "dC", "dM", "VC", "dA", "dL",
+                               "tL", "scale" };
+
+// worst relative difference between the columns of each quantity
+static void compare(const DistanceColumns& d, const DistanceColumns32& f,
+                    double* worst)
+{
+    const vector<double>* dc[] = { &d.rhoCrit, &d.dC, &d.dM, &d.VC,
+                                   &d.dA, &d.dL, &d.tL, &d.scale };
+    const vector<float>* fc[] = { &f.rhoCrit, &f.dC, &f.dM, &f.VC,
+                                  &f.dA, &f.dL, &f.tL, &f.scale };
+    for (size_t q = 0; q < 8; ++q)
+        for (size_t i = 0; i < dc[q]->size(); ++i)
+        {
+            double a = (*dc[q])[i];
+            if (a)
+                worst[q] = max(worst[q], fabs((*fc[q])[i] / a - 1));
+        }
+}
+
+int main()
+{
+    const double params[][3] = { { 70, 0.3, 0.7 },    // flat, closed forms
+                                 { 70, 0.3, 0.6 },    // open
+                                 { 70, 0.3, 0.9 },    // closed
+                                 { 70, 0.3, 0 },      // open, no Lambda
+                                 { 70, 1, 0 },        // Einstein-de Sitter
+                                 { 70, 2, 0.2 },      // strongly closed
+                                 { 70, 0.05, 0.8 } }; // nearly empty
+    const Cosmo::Integrator engines[] = { Cosmo::ROMBERG,
+                                          Cosmo::GAUSS_KRONROD };
+
+    // uniform over [0, 20] plus the ends and redshifts close to zero
+    vector<double> z(20000);
+    mt19937 generator(1);
+    uniform_real_distribution<double> uniform(0, 20);
+    for (size_t i = 0; i < z.size(); ++i)
+        z[i] = uniform(generator);
+    const double special[] = { 0, 1e-8, 1e-6, 1e-4, 1e-3, 0.01, 20 };
+    copy(special, special + sizeof(special) / sizeof(special[0]), z.begin());
+
+    double worst[8] = { 0 };
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); ++i)
+        for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e)
+        {
+            Cosmo c(params[i][0], params[i][1], params[i][2]);
+            c.setIntegrator(engines[e]);
+            DistanceColumns d;
+            DistanceColumns32 f;
+            c.computeBatch(&z[0], z.size(), d);
+            c.computeBatch(&z[0], z.size(), f);
+            compare(d, f, worst);
+        }
+
+    int failures = 0;
+    for (size_t q = 0; q < 8; ++q)
+    {
+        printf("float_test: %-8s %.2e\n", names[q], worst[q]);
+        if (!(worst[q] <= bound))
+            ++failures;
+    }
+    printf("float_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
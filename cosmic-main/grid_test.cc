@@ -0,0 +1,83 @@
+/*******************************************************************************
+Test that parameter grids do not depend on the number of threads
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "cosmo.h"
+
+using namespace std;
+
+// true if the two cubes hold the same bits
+static bool same(const GridCube& a, const GridCube& b)
+{
+    return a.values.size() == b.values.size() && a.age.size() == b.age.size()
+        && !memcmp(a.values.data(), b.values.data(),
+                   a.values.size() * sizeof(double))
+        && !memcmp(a.age.data(), b.age.data(), a.age.size() * sizeof(double));
+}
+
+int main()
+{
+    // scans in H0 over flat, open and closed cosmologies, interleaved so
+    // that the sort has to bring each group together
+    vector<CosmoParams> params;
+    for (int h = 55; h < 80; ++h)
+        for (double om = 0.25; om < 0.4; om += 0.05)
+            for (double ol = 0.5; ol < 0.85; ol += 0.1)
+            {
+                CosmoParams p = { double(h), om, ol };
+                params.push_back(p);
+            }
+    vector<double> z;
+    for (int j = 0; j < 50; ++j)
+        z.push_back(0.05 * j * j);
+
+    GridCube serial;
+    Scheduler one(1);
+    sweepGrid(params, z, Cosmo::ALL, serial, one);
+
+    int failures = 0;
+    const int threads[] = { 2, 3, 4, 8 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+        // the smallest grain gives the most chunks and steals
+        Scheduler many(threads[t], 1);
+        for (int run = 0; run < 5; ++run)
+        {
+            GridCube cube;
+            sweepGrid(params, z, Cosmo::ALL, cube, many);
+            if (!same(serial, cube))
+            {
+                printf("grid_test: %d threads differ from one in run %d\n",
+                       threads[t], run);
+                ++failures;
+                break;
+            }
+        }
+    }
+    printf("grid_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,334 @@
+/*******************************************************************************
+Numerical integration routines for the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#ifndef __INTEGRATE_H__
+#define __INTEGRATE_H__
+
+#include <cmath>
+#include <algorithm>
+
+// The integrators are templates on the integrand, so any callable (function,
+// functor or lambda) can be passed and is inlined into the inner loops.
+//
+// Scalar integrands are called as f(x) and return a double. Vector-valued
+// integrands with M components are called as f(x, out) and store their
+// values in out[0..M-1]; all components are integrated over shared
+// abscissae and must all converge. The vector-valued forms do their
+// arithmetic in the type T of out, double or float; the abscissae are
+// always doubles.
+
+////////////////////////////////////////////////////////////////////////////////
+// Romberg integration
+////////////////////////////////////////////////////////////////////////////////
+
+// Sum of the M components of f at a + k*h for odd k < np, the new points
+// of each trapezoidal refinement, into sum[0..M-1]. Integrands with a
+// member function sum(a, h, np, sum) that computes the same thing, e.g.
+// several abscissae at a time with SIMD instructions, are summed through
+// it; the generic version below is chosen for all others.
+template <int M, class F, class T>
+inline auto oddSum(F& f, double a, double h, int np, T* sum, int)
+    -> decltype(f.sum(a, h, np, sum), void())
+{
+    f.sum(a, h, np, sum);
+}
+
+template <int M, class F, class T>
+inline void oddSum(F& f, double a, double h, int np, T* sum, long)
+{
+    T fx[M];
+    int c;
+    for (c = 0; c < M; ++c)
+        sum[c] = 0.0;
+    for (int k = 1; k <= (np-1); k += 2)
+    {
+        f(a + k*h, fx);
+        for (c = 0; c < M; ++c)
+            sum[c] += fx[c];
+    }
+}
+
+// Romberg integration of the M components of f from a to b. Each row of the
+// tableau only needs the previous one, so two rows are kept on the stack
+// and swapped after every level.
+template <int M, class F, class T>
+void romberg(F f, double a, double b, T* result, double prec = 1e-8)
+{
+    double h = b - a;     // coarsest panel size
+    int np = 1;           // Current number of panels
+    const int N = 25;     // maximum iterations
+    T rows[2][N*M];
+    T* prev = rows[0];    // R(i-1, ...), M components per entry
+    T* cur = rows[1];     // R(i, ...)
+    T fa[M], fb[M];
+    int c;
+    // Compute the first term R(1,1)
+    f(a, fa);
+    f(b, fb);
+    for (c = 0; c < M; ++c)
+        prev[c] = h/2 * (fa[c] + fb[c]);
+
+    // Loop over the desired number of rows, i = 2,...,N
+    int i,j;
+    for(i = 1; i < N; ++i)
+    {
+        // Compute the summation in the recursive trapezoidal rule
+        h /= 2.0;          // Use panels half the previous size
+        np *= 2;           // Use twice as many panels
+        T sumT[M];
+        oddSum<M>(f, a, h, np, sumT, 0);
+
+        // Compute Romberg table entries R(i,1), R(i,2), ..., R(i,i)
+        for (c = 0; c < M; ++c)
+            cur[c] = T(0.5) * prev[c] + T(h) * sumT[c];
+        int p = 1;
+        for( j=1; j<i; ++j )
+        {
+            p *= 4;
+            for (c = 0; c < M; ++c)
+                cur[j*M+c] = cur[(j-1)*M+c] +
+                    (cur[(j-1)*M+c] - prev[(j-1)*M+c]) / (p-1);
+        }
+        bool converged = true;
+        for (c = 0; c < M; ++c)
+        {
+            T dR = (j > 1) ? cur[(j-1)*M+c] - prev[(j-2)*M+c] : prev[c];
+            if (fabs(dR) >= prec)
+                converged = false;
+        }
+        if (converged)
+        {
+            for (c = 0; c < M; ++c)
+                result[c] = cur[(j-1)*M+c];
+            return;
+        }
+        T* t = prev;
+        prev = cur;
+        cur = t;
+    }
+    for (c = 0; c < M; ++c)
+        result[c] = prev[(N-2)*M+c];
+}
+
+// adapts a scalar integrand to the vector interface
+template <class F>
+struct ScalarIntegrand
+{
+    F& f;
+    ScalarIntegrand(F& func) : f(func) {}
+    inline void operator()(const double x, double* out) { out[0] = f(x); }
+};
+
+// Romberg integration of the scalar integrand f from a to b
+template <class F>
+double romberg(F f, double a, double b, double prec = 1e-8)
+{
+    double result;
+    romberg<1>(ScalarIntegrand<F>(f), a, b, &result, prec);
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Gauss-Kronrod integration
+////////////////////////////////////////////////////////////////////////////////
+
+// 15-point Kronrod rule on [a, b] for each of the M components of f. Sets
+// result to the Kronrod estimate and err to its difference from the
+// embedded 7-point Gauss rule.
+template <int M, class F, class T>
+void kronrod15(F& f, double a, double b, T* result, T* err)
+{
+    // abscissae and weights from QUADPACK's qk15
+    static const double xgk[8] = {
+        0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+        0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+        0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+        0.207784955007898467600689403773245, 0.0 };
+    static const double wgk[8] = {
+        0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+        0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+        0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+        0.204432940075298892414161999234649, 0.209482141084727828012999174891714 };
+    static const double wg[4] = {
+        0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+        0.381830050505118944950369775488975, 0.417959183673469387755102040816327 };
+
+    double center = 0.5 * (a + b);
+    double halfLength = 0.5 * (b - a);
+    T f1[M], f2[M], resG[M], resK[M];
+    int c;
+    f(center, f1);
+    for (c = 0; c < M; ++c)
+    {
+        resG[c] = f1[c] * T(wg[3]);
+        resK[c] = f1[c] * T(wgk[7]);
+    }
+    for (int j = 0; j < 7; ++j)
+    {
+        double dx = halfLength * xgk[j];
+        f(center - dx, f1);
+        f(center + dx, f2);
+        for (c = 0; c < M; ++c)
+        {
+            T fs = f1[c] + f2[c];
+            resK[c] += T(wgk[j]) * fs;
+            if (j % 2)
+                resG[c] += T(wg[j / 2]) * fs;
+        }
+    }
+    for (c = 0; c < M; ++c)
+    {
+        err[c] = fabs((resK[c] - resG[c]) * T(halfLength));
+        result[c] = resK[c] * T(halfLength);
+    }
+}
+
+// Globally adaptive Gauss-Kronrod integration (G7/K15 rule) of the M
+// components of f from a to b. The panel with the largest error estimate
+// is bisected until the summed error estimate of every component falls
+// below prec. Panels are kept in fixed-size arrays, so no memory is
+// allocated.
+template <int M, class F, class T>
+void gaussKronrod(F f, double a, double b, T* result, double prec = 1e-8)
+{
+    const int N = 100;     // maximum number of panels
+    double lo[N], hi[N];
+    T worstErr[N];
+    T val[N][M], err[N][M];
+    T errSum[M];
+    int c;
+    lo[0] = a;
+    hi[0] = b;
+    kronrod15<M>(f, a, b, val[0], err[0]);
+    worstErr[0] = 0;
+    for (c = 0; c < M; ++c)
+    {
+        errSum[c] = err[0][c];
+        worstErr[0] = std::max(worstErr[0], err[0][c]);
+    }
+    int n = 1;
+    for (;;)
+    {
+        bool converged = true;
+        for (c = 0; c < M; ++c)
+            if (errSum[c] > prec)
+                converged = false;
+        if (converged || n == N)
+            break;
+
+        // bisect the panel with the largest error estimate
+        int worst = 0;
+        for (int i = 1; i < n; ++i)
+            if (worstErr[i] > worstErr[worst])
+                worst = i;
+        double mid = 0.5 * (lo[worst] + hi[worst]);
+        lo[n] = mid;
+        hi[n] = hi[worst];
+        hi[worst] = mid;
+        for (c = 0; c < M; ++c)
+            errSum[c] -= err[worst][c];
+        kronrod15<M>(f, lo[worst], mid, val[worst], err[worst]);
+        kronrod15<M>(f, mid, hi[n], val[n], err[n]);
+        worstErr[worst] = worstErr[n] = 0;
+        for (c = 0; c < M; ++c)
+        {
+            errSum[c] += err[worst][c] + err[n][c];
+            worstErr[worst] = std::max(worstErr[worst], err[worst][c]);
+            worstErr[n] = std::max(worstErr[n], err[n][c]);
+        }
+        ++n;
+    }
+    // add up the panels afresh to shed the round-off accumulated above
+    for (c = 0; c < M; ++c)
+    {
+        result[c] = 0;
+        for (int i = 0; i < n; ++i)
+            result[c] += val[i][c];
+    }
+}
+
+// Gauss-Kronrod integration of the scalar integrand f from a to b
+template <class F>
+double gaussKronrod(F f, double a, double b, double prec = 1e-8)
+{
+    double result;
+    gaussKronrod<1>(ScalarIntegrand<F>(f), a, b, &result, prec);
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Double-exponential (tanh-sinh) integration
+////////////////////////////////////////////////////////////////////////////////
+
+// Tanh-sinh integration of f from a to b. The substitution
+// x = c + d tanh(pi/2 sinh t) clusters the abscissae doubly exponentially
+// towards both ends, so integrands with endpoint singularities or steep
+// endpoint behaviour, including improper integrals mapped onto a finite
+// interval, converge as quickly as smooth ones. f is never evaluated at a
+// or b. Each level halves the step in t; the number of evaluations is at
+// most 2 * 4.5 * 2^maxLevel, i.e. about 4600 for the maximum of 9 levels,
+// and the error roughly squares from one level to the next.
+template <class F>
+double tanhSinh(F f, double a, double b, double prec = 1e-12)
+{
+    const int maxLevel = 9;
+    const double tMax = 4.5;   // 1 - tanh(pi/2 sinh t) ~ 1e-61 at the cut-off
+    const double halfPi = 2 * atan(1.0);
+    double c = 0.5 * (a + b);
+    double d = 0.5 * (b - a);
+
+    // running sum of w(t) (f(c - d tanh u) + f(c + d tanh u)) over the
+    // abscissae, skipping any that round onto an endpoint
+    double h = 1;
+    double sum = halfPi * f(c);
+    double I = 0;
+    for (int level = 0; level <= maxLevel; ++level)
+    {
+        // level 0 takes every multiple of h, later levels only the odd ones
+        int step = level ? 2 : 1;
+        for (int k = 1; k * h <= tMax; k += step)
+        {
+            double t = k * h;
+            double u = halfPi * sinh(t);
+            double coshU = cosh(u);
+            double w = halfPi * cosh(t) / (coshU * coshU);
+            // 1 - tanh(u), formed directly so that abscissae close to the
+            // endpoints keep their full relative precision
+            double q = 2 / (1 + exp(2 * u));
+            double lo = a + d * q, hi = b - d * q;
+            if (lo > a)
+                sum += w * f(lo);
+            if (hi < b)
+                sum += w * f(hi);
+        }
+        double previous = I;
+        I = d * h * sum;
+        if (level > 2 && fabs(I - previous) < prec)
+            break;
+        h /= 2;
+    }
+    return I;
+}
+
+#endif // __INTEGRATE_H__
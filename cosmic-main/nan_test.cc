@@ -0,0 +1,91 @@
+/*******************************************************************************
+Test that a NaN redshift in a batch only affects its own row
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "cosmo.h"
+
+using namespace std;
+
+// Compares the columns of a batch with a NaN at position bad with those of
+// the same batch without it; returns the number of rows that are wrong.
+template <class Real>
+static int compare(const DistanceColumnsOf<Real>& with,
+                   const DistanceColumnsOf<Real>& without, const size_t bad)
+{
+    const vector<Real>* a[] = { &with.rhoCrit, &with.dC, &with.dM, &with.VC,
+                                &with.dA, &with.dL, &with.tL, &with.scale };
+    const vector<Real>* b[] = { &without.rhoCrit, &without.dC, &without.dM,
+                                &without.VC, &without.dA, &without.dL,
+                                &without.tL, &without.scale };
+    int wrong = 0;
+    for (size_t q = 0; q < 8; ++q)
+        for (size_t i = 0; i < a[q]->size(); ++i)
+        {
+            if (i == bad)
+                wrong += !std::isnan((*a[q])[i]);
+            else
+                wrong += (*a[q])[i] != (*b[q])[i - (i > bad)];
+        }
+    return wrong;
+}
+
+int main()
+{
+    const double params[][3] = { { 70, 0.3, 0.7 },    // flat, closed forms
+                                 { 70, 0.3, 0.6 },    // open
+                                 { 70, 0.3, 0.9 },    // closed
+                                 { 70, 1, 0 } };      // Einstein-de Sitter
+    const Cosmo::Integrator engines[] = { Cosmo::ROMBERG,
+                                          Cosmo::GAUSS_KRONROD };
+    const double with[] = { 0.5, 1, NAN, 2, 3 };
+    const double without[] = { 0.5, 1, 2, 3 };
+    const size_t bad = 2;
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); ++i)
+        for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e)
+        {
+            Cosmo c(params[i][0], params[i][1], params[i][2]);
+            c.setIntegrator(engines[e]);
+            DistanceColumns d, dRef;
+            DistanceColumns32 f, fRef;
+            c.computeBatch(with, 5, d);
+            c.computeBatch(without, 4, dRef);
+            c.computeBatch(with, 5, f);
+            c.computeBatch(without, 4, fRef);
+            int wrong = compare(d, dRef, bad) + compare(f, fRef, bad);
+            if (wrong)
+            {
+                printf("nan_test: %d wrong values for H0 = %g, Omega_m = %g, "
+                       "Omega_L = %g, engine %d\n", wrong, params[i][0],
+                       params[i][1], params[i][2], int(e));
+                ++failures;
+            }
+        }
+    printf("nan_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
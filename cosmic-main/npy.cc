@@ -0,0 +1,101 @@
+/*******************************************************************************
+Writer of NumPy .npy files for the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#include "npy.h"
+
+using namespace std;
+
+// Total size of the header. Version 1.0 of the format allows up to 65535
+// bytes; 128 leave room for any shape, so the header can be rewritten in
+// place once the length is known, and keep the data 64-byte aligned.
+const size_t headerSize = 128;
+
+NpyFile::NpyFile() : count_(0), columns_(0)
+{
+}
+
+NpyFile::~NpyFile()
+{
+    if (file_.is_open())
+        close();
+}
+
+bool NpyFile::open(const string& path, const size_t columns)
+{
+    if (file_.is_open())
+        close();
+    file_.clear();
+    file_.open(path.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!file_)
+        return false;
+    count_ = 0;
+    columns_ = columns;
+    writeHeader();
+    return bool(file_);
+}
+
+// writes the magic string, version, header length and the dictionary
+// describing the array as it stands
+void NpyFile::writeHeader()
+{
+    const uint16_t one = 1;
+    const bool little = 1 == *reinterpret_cast<const unsigned char*>(&one);
+    ostringstream dict;
+    dict << "{'descr': '" << (little ? '<' : '>') << "f8', "
+         << "'fortran_order': False, 'shape': (";
+    if (columns_)
+        dict << count_ / columns_ << ", " << columns_;
+    else
+        dict << count_ << ",";
+    dict << "), }";
+    string text = dict.str();
+    // pad with blanks up to the newline that ends the header
+    const size_t prefix = 10;
+    text.resize(headerSize - prefix - 1, ' ');
+    text += '\n';
+
+    const uint16_t length = text.size();
+    char start[prefix] = { '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                           char(length & 0xff), char(length >> 8) };
+    file_.seekp(0);
+    file_.write(start, prefix);
+    file_.write(text.data(), text.size());
+}
+
+void NpyFile::write(const double* values, const size_t n)
+{
+    file_.write(reinterpret_cast<const char*>(values), n * sizeof(double));
+    count_ += n;
+}
+
+bool NpyFile::close()
+{
+    writeHeader();
+    file_.close();
+    return !file_.fail();
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+Writer of NumPy .npy files for the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#ifndef __NPY_H__
+#define __NPY_H__
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Array of doubles written to a NumPy .npy file
+////////////////////////////////////////////////////////////////////////////////
+//
+// The values are written in the byte order of the machine, which the
+// header records, so numpy.load() reads them back without any conversion.
+// The array may be written in any number of pieces; its length is only
+// known, and put into the header, when the file is closed.
+class NpyFile
+{
+private:
+    ofstream file_;
+    size_t count_;          // values written
+    size_t columns_;        // length of the rows of a 2-d array, or 0
+    void writeHeader();
+
+    NpyFile(const NpyFile&);
+    NpyFile& operator=(const NpyFile&);
+
+public:
+    NpyFile();
+    ~NpyFile();
+
+    // Creates the file for a 1-d array or, if columns is non-zero, a 2-d
+    // array of rows of that length; returns false if it cannot be created
+    bool open(const string&, const size_t columns = 0);
+    void write(const double*, const size_t); // append values
+    // Puts the final shape into the header and closes the file; returns
+    // false if anything could not be written
+    bool close();
+
+    inline size_t size() const { return count_; } // values written so far
+};
+
+#endif // __NPY_H__
@@ -1,58 +1,105 @@
-#include <iostream>
-#include <fstream>
-#include "cosmo.h"
-
-using namespace std;
-
-int main(){
-    // Open a file
-    string filename = "redshifts.txt";
-    ifstream file;
-    file.open(filename);
-
-    // Frist line of file contains the three parameters
-    double C1,C2,C3;
-    file >> C1 >> C2 >> C3;
-
-    // Second line of file contains the number of redshifts
-    int N;
-    file >> N;
-
-    cout << N << endl;
-
-    // Create an array for the redshifts
-    double* redshifts = new double[N]; 
-
-    // Then we read the redshifts
-    for (int i=0;i<N;i++){
-        file >> redshifts[i];
-    }
-
-    // Close the file
-    file.close();
-
-    // Open the output file
-    ofstream outfile;
-    outfile.open("results.csv");
-
-    // Write a header
-    outfile << "Angular Diameter Distance (Mpc), Luminosity Distance (Mpc), Comoving Radial Distance (Mpc), Comoving Transverse Distance (Mpc)" << endl;
-
-    // Now create the cosmo stuff
-    Cosmo* c = new Cosmo(C1,C2,C3);
-
-    // For all the redshift values print out the necessary constants on the file
-    for (int i=0;i<N;i++){
-        c->setRedshift(redshifts[i]);
-
-        // Write the data to the file
-        outfile << c->dA() << "," << c->dL() << "," << c->dC() << "," << c->dM() << endl;
-        cout << redshifts[i] << endl;
-    }
-
-    // Close the output file
-    outfile.close();
-
-    return 0;
-}
-
+#include <iostream>
+#include <fstream>
+#include "cosmo.h"
+#include "npy.h"
+
+using namespace std;
+
+// With the argument "npy" the distances are written to one NumPy file per
+// quantity, results_<quantity>.npy, instead of to results.csv
+int main(int argc, char** argv){
+    bool npy = argc > 1 && string(argv[1]) == "npy";
+
+    // Open a file
+    string filename = "redshifts.txt";
+    ifstream file;
+    file.open(filename);
+
+    // Frist line of file contains the three parameters
+    double C1,C2,C3;
+    file >> C1 >> C2 >> C3;
+
+    // Second line of file contains the number of redshifts
+    int N;
+    file >> N;
+
+    cout << N << endl;
+
+    // Create an array for the redshifts
+    double* redshifts = new double[N]; 
+
+    // Then we read the redshifts
+    for (int i=0;i<N;i++){
+        file >> redshifts[i];
+    }
+
+    // Close the file
+    file.close();
+
+    // Open the output file
+    ofstream outfile;
+    if (!npy){
+        outfile.open("results.csv");
+
+        // Write a header
+        outfile << "Angular Diameter Distance (Mpc), Luminosity Distance (Mpc), Comoving Radial Distance (Mpc), Comoving Transverse Distance (Mpc)" << endl;
+    }
+
+    // Now create the cosmo stuff
+    Cosmo* c = new Cosmo(C1,C2,C3);
+
+    // Each distinct redshift is evaluated only once
+    vector<double> unique;
+    vector<size_t> index;
+    size_t U = uniqueRedshifts(redshifts, N, unique, index);
+    vector<double> dA(U), dL(U), dC(U), dM(U);
+    for (size_t j=0;j<U;j++){
+        c->setRedshift(unique[j]);
+        dA[j] = c->dA();
+        dL[j] = c->dL();
+        dC[j] = c->dC();
+        dM[j] = c->dM();
+    }
+
+    // For all the redshift values print out the necessary constants on the file
+    vector<double> columns[4];
+    for (int i=0;i<N;i++){
+        size_t j = index[i];
+
+        // Write the data to the file
+        if (npy){
+            columns[0].push_back(dA[j]);
+            columns[1].push_back(dL[j]);
+            columns[2].push_back(dC[j]);
+            columns[3].push_back(dM[j]);
+        }
+        else
+            outfile << dA[j] << "," << dL[j] << "," << dC[j] << "," << dM[j] << endl;
+        cout << redshifts[i] << endl;
+    }
+    if (npy){
+        const char* names[5] = {"z", "dA", "dL", "dC", "dM"};
+        for (int k=0;k<5;k++){
+            NpyFile file;
+            string name = string("results_") + names[k] + ".npy";
+            if (!file.open(name)){
+                cerr << "Error opening output file: " << name << endl;
+                return 1;
+            }
+            if (k)
+                file.write(columns[k-1].data(), columns[k-1].size());
+            else
+                file.write(redshifts, N);
+            file.close();
+        }
+    }
+    if (U)
+        cout << U << " distinct redshifts (dedup ratio " << double(N) / U << ")" << endl;
+
+    // Close the output file
+    if (!npy)
+        outfile.close();
+
+    return 0;
+}
+
@@ -0,0 +1,230 @@
+/*******************************************************************************
+Memory-mapped reader of redshift batch files for the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "redshiftfile.h"
+
+using namespace std;
+
+// blanks allowed around the number on a line
+static inline bool isBlank(const char c)
+{
+    return ' ' == c || '\t' == c || '\r' == c;
+}
+
+// Parses the lines in [begin, end), which starts at the beginning of a line
+// and ends at the end of one, into z. Returns the start of the first
+// malformed line, or end if there is none.
+static const char* parseLines(const char* begin, const char* end,
+                              vector<double>& z)
+{
+    z.clear();
+    const char* p = begin;
+    while (p < end)
+    {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        const char* q = p;
+        while (q < eol && isBlank(*q))
+            ++q;
+        double value;
+        from_chars_result r = from_chars(q, eol, value);
+        if (r.ec != errc() || !isfinite(value))
+            return p;
+        for (q = r.ptr; q < eol && isBlank(*q); ++q)
+            ;
+        if (q != eol)
+            return p;
+        z.push_back(value);
+        p = eol + 1;
+    }
+    return end;
+}
+
+RedshiftFile::RedshiftFile()
+    : data_(0), size_(0), pos_(0), base_(0), line_(0), fd_(-1),
+      mapped_(false), eof_(true), badOffset_(0), badLine_(0)
+{
+}
+
+RedshiftFile::~RedshiftFile()
+{
+    close();
+}
+
+bool RedshiftFile::open(const string& path)
+{
+    close();
+    int fd = "-" == path ? 0 : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void* p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+            size_ = st.st_size;
+            mapped_ = true;
+        }
+    }
+    if (mapped_ || (!fstat(fd, &st) && S_ISREG(st.st_mode) && !st.st_size))
+    {
+        if (fd)
+            ::close(fd);
+        return true;
+    }
+    // not a regular file, or one that cannot be mapped: stream it
+    fd_ = fd;
+    eof_ = false;
+    return true;
+}
+
+void RedshiftFile::close()
+{
+    if (mapped_)
+        munmap(const_cast<char*>(data_), size_);
+    if (fd_ > 0)
+        ::close(fd_);
+    fd_ = -1;
+    mapped_ = false;
+    eof_ = true;
+    vector<char>().swap(buffer_);
+    data_ = 0;
+    size_ = pos_ = base_ = line_ = badOffset_ = badLine_ = 0;
+}
+
+// Drops the lines already read from the buffer of a stream and reads until
+// it holds at least maxBytes and a line end, or the rest of the stream.
+// Read errors end the stream like the end of the file.
+void RedshiftFile::refill(const size_t maxBytes)
+{
+    buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+    base_ += pos_;
+    pos_ = 0;
+    const size_t chunk = 65536;
+    size_t want = max(maxBytes, size_t(1));
+    size_t scanned = 0;     // bytes known to hold no line end
+    while (!eof_)
+    {
+        size_t have = buffer_.size();
+        if (have >= want && memchr(buffer_.data() + scanned, '\n',
+                                   have - scanned))
+            break;
+        if (have >= want)
+            scanned = have;
+        buffer_.resize(max(have + chunk, want));
+        ssize_t n;
+        do
+            n = read(fd_, &buffer_[have], buffer_.size() - have);
+        while (n < 0 && EINTR == errno);
+        if (n <= 0)
+        {
+            eof_ = true;
+            n = 0;
+        }
+        buffer_.resize(have + n);
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+bool RedshiftFile::next(const size_t maxBytes, Scheduler& scheduler,
+                        vector<double>& z)
+{
+    z.clear();
+    if (fd_ >= 0)
+        refill(maxBytes);
+    if (done())
+        return true;
+
+    // the offset just past the end of the line containing offset i
+    auto lineEnd = [this](const size_t i)
+    {
+        const void* eol = memchr(data_ + i, '\n', size_ - i);
+        return eol ? static_cast<const char*>(eol) - data_ + 1 : size_;
+    };
+    size_t begin = pos_;
+    size_t end = size_;
+    if (maxBytes < size_ - begin)
+        end = lineEnd(begin + max(maxBytes, size_t(1)) - 1);
+    if (!eof_ && '\n' != data_[end - 1])
+    {
+        // the buffer of a stream ends within a line, which stays for the
+        // next block
+        const void* last = memrchr(data_ + begin, '\n', end - begin);
+        end = static_cast<const char*>(last) - data_ + 1;
+    }
+
+    // a few pieces per thread, but none much below 64 kB
+    size_t n = min(size_t(4 * scheduler.threads()),
+                   max(size_t(1), (end - begin) >> 16));
+    vector<size_t> bounds(n + 1);
+    bounds[0] = begin;
+    for (size_t k = 1; k < n; ++k)
+    {
+        size_t target = begin + (end - begin) * k / n;
+        bounds[k] = target <= bounds[k - 1] ? bounds[k - 1]
+                                            : min(end, lineEnd(target - 1));
+    }
+    bounds[n] = end;
+
+    pieces_.resize(n);
+    vector<size_t> bad(n);
+    scheduler.run(n, [&](size_t first, size_t last, int)
+    {
+        for (size_t k = first; k < last; ++k)
+            bad[k] = parseLines(data_ + bounds[k], data_ + bounds[k + 1],
+                                pieces_[k]) - data_;
+    });
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        z.insert(z.end(), pieces_[k].begin(), pieces_[k].end());
+        if (bad[k] < bounds[k + 1])
+        {
+            pos_ = bad[k];
+            badOffset_ = base_ + pos_;
+            line_ += z.size();
+            badLine_ = line_ + 1;
+            return false;
+        }
+    }
+    pos_ = end;
+    line_ += z.size();
+    return true;
+}
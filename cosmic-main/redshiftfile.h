@@ -0,0 +1,93 @@
+/*******************************************************************************
+Memory-mapped reader of redshift batch files for the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#ifndef __REDSHIFTFILE_H__
+#define __REDSHIFTFILE_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "scheduler.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Reader of files with one redshift per line
+////////////////////////////////////////////////////////////////////////////////
+//
+// The file is mapped into memory and the numbers are parsed in place with
+// std::from_chars, so no line is ever copied and lines may be of any
+// length. Each line holds one number, optionally surrounded by blanks or
+// followed by a carriage return; anything else, including an empty line,
+// is malformed. Files that cannot be mapped, e.g. pipes and the standard
+// input, are streamed through a buffer of about one block instead, so
+// input of any size is read in bounded memory.
+class RedshiftFile
+{
+private:
+    const char* data_;      // the mapping, or the buffer of a stream
+    size_t size_;
+    size_t pos_;            // offset in data_ of the first line not yet read
+    size_t base_;           // byte offset of data_ in the file
+    size_t line_;           // number of lines read
+    int fd_;                // descriptor of a stream, or -1
+    bool mapped_;           // data_ is a mapping rather than buffer_
+    bool eof_;              // all of the file is in data_
+    vector<char> buffer_;
+    size_t badOffset_, badLine_;
+    vector<vector<double> > pieces_; // per-piece results of next()
+
+    void refill(const size_t);
+
+    RedshiftFile(const RedshiftFile&);
+    RedshiftFile& operator=(const RedshiftFile&);
+
+public:
+    RedshiftFile();
+    ~RedshiftFile();
+
+    // maps the file, or streams it if it cannot be mapped; "-" is the
+    // standard input. Returns false if it cannot be opened.
+    bool open(const string&);
+    void close();
+
+    // Replaces z by the redshifts of the lines in the next block of about
+    // maxBytes bytes, which always ends with a complete line. The block is
+    // split at line ends into pieces that the threads of the scheduler
+    // parse in parallel. Returns false if the block contains a malformed
+    // line; z then holds the redshifts of the lines before it, and
+    // badOffset() and badLine() tell where it is.
+    bool next(const size_t maxBytes, Scheduler&, vector<double>& z);
+
+    // inspection functions
+    inline bool done() const { return eof_ && pos_ == size_; } // all read
+    inline size_t lines() const { return line_; } // lines read so far
+    // byte offset from the start of the file, and number (from 1), of the
+    // malformed line found by next()
+    inline size_t badOffset() const { return badOffset_; }
+    inline size_t badLine() const { return badLine_; }
+};
+
+#endif // __REDSHIFTFILE_H__
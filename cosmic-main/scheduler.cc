@@ -0,0 +1,134 @@
+/*******************************************************************************
+Work-stealing scheduler for parallel batches in the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "scheduler.h"
+
+using namespace std;
+
+// the part of the batch a thread still has to run, [begin, end)
+struct Share
+{
+    mutex lock;
+    size_t begin, end;
+};
+
+// runs the shares of the batch as thread number t of the scheduler
+static void work(const int t, vector<Share>& shares, const size_t grain,
+                 const function<void(size_t, size_t, int)>& body,
+                 double& busy, size_t& chunks, size_t& steals)
+{
+    const int nThreads = shares.size();
+    Share& own = shares[t];
+    for (;;)
+    {
+        // take a chunk from the front of our own share
+        size_t begin, end;
+        {
+            lock_guard<mutex> guard(own.lock);
+            size_t left = own.end - own.begin;
+            if (left)
+            {
+                begin = own.begin;
+                end = begin + min(left, max(grain, left / 8));
+                own.begin = end;
+            }
+            else
+                begin = end = 0;
+        }
+        if (begin < end)
+        {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            body(begin, end, t);
+            busy += chrono::duration<double>(chrono::steady_clock::now()
+                                             - start).count();
+            ++chunks;
+            continue;
+        }
+
+        // our share is done: steal the back half of another one. Only its
+        // owner ever refills a share, so when none has work left all that
+        // remains is already running and this thread can stop.
+        bool stolen = false;
+        for (int i = 1; i < nThreads && !stolen; ++i)
+        {
+            Share& victim = shares[(t + i) % nThreads];
+            {
+                lock_guard<mutex> guard(victim.lock);
+                size_t left = victim.end - victim.begin;
+                if (!left)
+                    continue;
+                end = victim.end;
+                victim.end -= (left + 1) / 2;
+                begin = victim.end;
+            }
+            // the victim's lock is released first, so that no thread ever
+            // holds two locks
+            lock_guard<mutex> guard(own.lock);
+            own.begin = begin;
+            own.end = end;
+            stolen = true;
+        }
+        if (!stolen)
+            return;
+        ++steals;
+    }
+}
+
+Scheduler::Scheduler(const int threads, const size_t grain)
+{
+    threads_ = threads > 0 ? threads : max(1u, thread::hardware_concurrency());
+    grain_ = max(grain, size_t(1));
+    clearStatistics();
+}
+
+void Scheduler::run(const size_t n,
+                    const function<void(size_t, size_t, int)>& body)
+{
+    vector<Share> shares(threads_);
+    for (int t = 0; t < threads_; ++t)
+    {
+        shares[t].begin = n * t / threads_;
+        shares[t].end = n * (t + 1) / threads_;
+    }
+    vector<thread> workers;
+    for (int t = 1; t < threads_; ++t)
+        workers.push_back(thread(work, t, ref(shares), grain_, cref(body),
+                                 ref(busy_[t]), ref(chunks_[t]),
+                                 ref(steals_[t])));
+    work(0, shares, grain_, body, busy_[0], chunks_[0], steals_[0]);
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+void Scheduler::clearStatistics()
+{
+    busy_.assign(threads_, 0.0);
+    chunks_.assign(threads_, 0);
+    steals_.assign(threads_, 0);
+}
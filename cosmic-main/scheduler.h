@@ -0,0 +1,77 @@
+/*******************************************************************************
+Work-stealing scheduler for parallel batches in the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+// Scheduler that runs the items of a batch on several threads
+////////////////////////////////////////////////////////////////////////////////
+//
+// Every thread starts with an equal, contiguous share of the items and
+// works through it from the front in chunks of an eighth of what it has
+// left, but no fewer than the grain size, so the chunks shrink as its share
+// runs out. A thread whose share is empty steals the back half of what the
+// next thread with work left still has to do. Items whose cost varies a
+// lot, e.g. redshifts of a catalog with a tail of quasars, therefore keep
+// all the threads busy until the end of the batch.
+class Scheduler
+{
+private:
+    int threads_;
+    size_t grain_;
+    vector<double> busy_;       // seconds spent in the body, per thread
+    vector<size_t> chunks_;     // chunks run, per thread
+    vector<size_t> steals_;     // successful steals, per thread
+
+public:
+    // Number of threads (0 = one per processor) and the smallest chunk
+    Scheduler(const int threads = 0, const size_t grain = 8);
+
+    // Calls body(begin, end, thread) for disjoint ranges [begin, end) that
+    // together cover [0, n), and returns when all of them are done. thread
+    // is the index, in [0, threads()), of the thread making the call; the
+    // calling thread takes part as thread 0. A range may be run on any
+    // thread, but no two calls with the same thread index overlap in time.
+    void run(const size_t n, const function<void(size_t, size_t, int)>& body);
+
+    // inspection functions
+    inline int threads() const { return threads_; }
+    inline size_t grain() const { return grain_; }
+    // per-thread totals over all calls of run() since construction or the
+    // last call of clearStatistics()
+    inline const vector<double>& busyTime() const { return busy_; }
+    inline const vector<size_t>& chunks() const { return chunks_; }
+    inline const vector<size_t>& steals() const { return steals_; }
+
+    void clearStatistics();
+};
+
+#endif // __SCHEDULER_H__
@@ -0,0 +1,229 @@
+/*******************************************************************************
+Portable SIMD vector type for the cosmology library
+Copyright (C) 2003-2021  Joshua Kempner
+
+Version 2.2
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+Please send any bug fixes, enhancements, or useful comments by email to
+josh@kempner.net.
+*******************************************************************************/
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <cmath>
+
+// VecD holds VecD::width doubles, and VecF twice as many floats, and they
+// support the arithmetic needed by the integrand kernels. The widest
+// instruction set enabled at compile time is used: AVX-512 (8 doubles),
+// AVX (4), SSE2 (2), or plain scalar code (1). Build with e.g.
+// ARCH=-march=native to get more than SSE2 on x86-64.
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+struct VecD
+{
+    static const int width = 8;
+    __m512d v;
+    VecD() {}
+    VecD(__m512d a) : v(a) {}
+    explicit VecD(const double a) : v(_mm512_set1_pd(a)) {}
+    static VecD load(const double* p) { return _mm512_loadu_pd(p); }
+    void store(double* p) const { _mm512_storeu_pd(p, v); }
+    double sum() const
+    {
+        double t[width];
+        store(t);
+        return ((t[0] + t[4]) + (t[2] + t[6])) + ((t[1] + t[5]) + (t[3] + t[7]));
+    }
+};
+inline VecD operator+(VecD a, VecD b) { return _mm512_add_pd(a.v, b.v); }
+inline VecD operator-(VecD a, VecD b) { return _mm512_sub_pd(a.v, b.v); }
+inline VecD operator*(VecD a, VecD b) { return _mm512_mul_pd(a.v, b.v); }
+inline VecD operator/(VecD a, VecD b) { return _mm512_div_pd(a.v, b.v); }
+// the masked form avoids the uninitialized pass-through operand of
+// _mm512_sqrt_pd, which GCC 12 warns about
+inline VecD sqrt(VecD a) { return _mm512_maskz_sqrt_pd(0xFF, a.v); }
+
+struct VecF
+{
+    static const int width = 16;
+    __m512 v;
+    VecF() {}
+    VecF(__m512 a) : v(a) {}
+    explicit VecF(const float a) : v(_mm512_set1_ps(a)) {}
+    static VecF load(const float* p) { return _mm512_loadu_ps(p); }
+    void store(float* p) const { _mm512_storeu_ps(p, v); }
+    float sum() const
+    {
+        float t[width];
+        store(t);
+        float s = 0;
+        for (int i = 0; i < width; ++i)
+            s += t[i];
+        return s;
+    }
+};
+inline VecF operator+(VecF a, VecF b) { return _mm512_add_ps(a.v, b.v); }
+inline VecF operator-(VecF a, VecF b) { return _mm512_sub_ps(a.v, b.v); }
+inline VecF operator*(VecF a, VecF b) { return _mm512_mul_ps(a.v, b.v); }
+inline VecF operator/(VecF a, VecF b) { return _mm512_div_ps(a.v, b.v); }
+inline VecF sqrt(VecF a) { return _mm512_maskz_sqrt_ps(0xFFFF, a.v); }
+
+#elif defined(__AVX__)
+
+#include <immintrin.h>
+struct VecD
+{
+    static const int width = 4;
+    __m256d v;
+    VecD() {}
+    VecD(__m256d a) : v(a) {}
+    explicit VecD(const double a) : v(_mm256_set1_pd(a)) {}
+    static VecD load(const double* p) { return _mm256_loadu_pd(p); }
+    void store(double* p) const { _mm256_storeu_pd(p, v); }
+    double sum() const
+    {
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+};
+inline VecD operator+(VecD a, VecD b) { return _mm256_add_pd(a.v, b.v); }
+inline VecD operator-(VecD a, VecD b) { return _mm256_sub_pd(a.v, b.v); }
+inline VecD operator*(VecD a, VecD b) { return _mm256_mul_pd(a.v, b.v); }
+inline VecD operator/(VecD a, VecD b) { return _mm256_div_pd(a.v, b.v); }
+inline VecD sqrt(VecD a) { return _mm256_sqrt_pd(a.v); }
+
+struct VecF
+{
+    static const int width = 8;
+    __m256 v;
+    VecF() {}
+    VecF(__m256 a) : v(a) {}
+    explicit VecF(const float a) : v(_mm256_set1_ps(a)) {}
+    static VecF load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+    float sum() const
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+};
+inline VecF operator+(VecF a, VecF b) { return _mm256_add_ps(a.v, b.v); }
+inline VecF operator-(VecF a, VecF b) { return _mm256_sub_ps(a.v, b.v); }
+inline VecF operator*(VecF a, VecF b) { return _mm256_mul_ps(a.v, b.v); }
+inline VecF operator/(VecF a, VecF b) { return _mm256_div_ps(a.v, b.v); }
+inline VecF sqrt(VecF a) { return _mm256_sqrt_ps(a.v); }
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+struct VecD
+{
+    static const int width = 2;
+    __m128d v;
+    VecD() {}
+    VecD(__m128d a) : v(a) {}
+    explicit VecD(const double a) : v(_mm_set1_pd(a)) {}
+    static VecD load(const double* p) { return _mm_loadu_pd(p); }
+    void store(double* p) const { _mm_storeu_pd(p, v); }
+    double sum() const { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+};
+inline VecD operator+(VecD a, VecD b) { return _mm_add_pd(a.v, b.v); }
+inline VecD operator-(VecD a, VecD b) { return _mm_sub_pd(a.v, b.v); }
+inline VecD operator*(VecD a, VecD b) { return _mm_mul_pd(a.v, b.v); }
+inline VecD operator/(VecD a, VecD b) { return _mm_div_pd(a.v, b.v); }
+inline VecD sqrt(VecD a) { return _mm_sqrt_pd(a.v); }
+
+struct VecF
+{
+    static const int width = 4;
+    __m128 v;
+    VecF() {}
+    VecF(__m128 a) : v(a) {}
+    explicit VecF(const float a) : v(_mm_set1_ps(a)) {}
+    static VecF load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+    float sum() const
+    {
+        __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+};
+inline VecF operator+(VecF a, VecF b) { return _mm_add_ps(a.v, b.v); }
+inline VecF operator-(VecF a, VecF b) { return _mm_sub_ps(a.v, b.v); }
+inline VecF operator*(VecF a, VecF b) { return _mm_mul_ps(a.v, b.v); }
+inline VecF operator/(VecF a, VecF b) { return _mm_div_ps(a.v, b.v); }
+inline VecF sqrt(VecF a) { return _mm_sqrt_ps(a.v); }
+
+#else
+
+struct VecD
+{
+    static const int width = 1;
+    double v;
+    VecD() {}
+    explicit VecD(const double a) : v(a) {}
+    static VecD load(const double* p) { return VecD(*p); }
+    void store(double* p) const { *p = v; }
+    double sum() const { return v; }
+};
+inline VecD operator+(VecD a, VecD b) { return VecD(a.v + b.v); }
+inline VecD operator-(VecD a, VecD b) { return VecD(a.v - b.v); }
+inline VecD operator*(VecD a, VecD b) { return VecD(a.v * b.v); }
+inline VecD operator/(VecD a, VecD b) { return VecD(a.v / b.v); }
+inline VecD sqrt(VecD a) { return VecD(std::sqrt(a.v)); }
+
+struct VecF
+{
+    static const int width = 1;
+    float v;
+    VecF() {}
+    explicit VecF(const float a) : v(a) {}
+    static VecF load(const float* p) { return VecF(*p); }
+    void store(float* p) const { *p = v; }
+    float sum() const { return v; }
+};
+inline VecF operator+(VecF a, VecF b) { return VecF(a.v + b.v); }
+inline VecF operator-(VecF a, VecF b) { return VecF(a.v - b.v); }
+inline VecF operator*(VecF a, VecF b) { return VecF(a.v * b.v); }
+inline VecF operator/(VecF a, VecF b) { return VecF(a.v / b.v); }
+inline VecF sqrt(VecF a) { return VecF(std::sqrt(a.v)); }
+
+#endif
+
+inline VecD& operator+=(VecD& a, VecD b) { return a = a + b; }
+inline VecF& operator+=(VecF& a, VecF b) { return a = a + b; }
+
+// the vector type for the scalar type Real
+template <class Real> struct Simd;
+template <> struct Simd<double> { typedef VecD type; };
+template <> struct Simd<float> { typedef VecF type; };
+
+// the lane offsets 0, 1, ..., width-1
+template <class V, class Real>
+inline V laneIndex()
+{
+    Real k[V::width];
+    for (int i = 0; i < V::width; ++i)
+        k[i] = i;
+    return V::load(k);
+}
+
+#endif // __SIMD_H__